@@ -6,6 +6,10 @@
 #include "esp_log.h"
 #include "esp_timer.h"
 #include "Userbuttons.h"
+#include "button_gestures.h"
+#include "buzzer_patterns.h"
+#include "wake_scheduler.h"
+#include "wake_phases.h"
 #include "user_control.h"
 #include "i2c_config.h"
 #include "iaq_ui.h"
@@ -13,9 +17,6 @@
 #include "ui_screen_inits.h"
 #include "i2c_config.h"
 
-#define TEN_SECOND_HOLD   (10000000)  // 10 seconds in microseconds
-#define THREE_SECOND_HOLD (3000000)   // 3 seconds in mircoseconds
-
 static const char *TAG = "POWER_BTN";
 
 // Variables stored that keep track of is buzzers were acknowledged for deep sleep purposes
@@ -61,94 +62,83 @@ void check_if_either_buzzer_on()
     {
         safety_buzzer_acked = true;
     }
-}
-
-/*******************************************
- * @brief This function checks if the power button has been held for ten seconds.
- * @returns true if it has been held for at least 10 seconds, otherwise returns false
- ******************************************/
-bool pwr_held_for_ten_seconds(uint32_t press_time)
-{
-    uint32_t current_time = esp_timer_get_time();
-    // While the button is still held and it has not yet been ten seconds, continue delaying
-    while((gpio_get_level(PWR_BTN_PIN) == 0) && (current_time < (press_time + TEN_SECOND_HOLD)))
-    {
-        vTaskDelay(pdMS_TO_TICKS(100));
-        current_time = esp_timer_get_time();
-    }
-
-    if(current_time >= (press_time + TEN_SECOND_HOLD))
+    // The alarms are only evaluated when something changes, so have the display task turn the buzzers off now
+    if(user_buzzer_acked || safety_buzzer_acked)
     {
-        set_powering_down_screen();
-
-        // Wait until button is released to return true. This prevents the device instantly powering back on if this was not implemented
-        while(gpio_get_level(PWR_BTN_PIN) == 0)
-        {
-            vTaskDelay(pdMS_TO_TICKS(50));
-        }
-        return true;
+        notify_display_task(DISPLAY_NOTIFY_ALARM_INPUTS);
     }
-
-    return false;
 }
 
+/**************************************
+ * @brief Held for three seconds and released: turn the display off and deep sleep. The power button wakes the device,
+ *        otherwise it wakes when the next measurement is due and then carries on with the normal sleep cycle
+ **************************************/
+static void pwr_btn_enter_sleep()
+{
+    int64_t sleep_entry_start_us = wake_phase_begin();
+    power_down_display();
+    vTaskDelay(pdMS_TO_TICKS(100));
+    buzzer_prepare_for_sleep();
+    esp_sleep_enable_ext0_wakeup(PWR_BTN_PIN, 0);          // Wake-up from deep sleep when the power button is pressed
+    uint64_t sleep_time_us = wake_scheduler_get_sleep_time_us();
+    esp_sleep_enable_timer_wakeup(sleep_time_us);          // If no button was pressed, wake up for the next measurement, then it proceeds with normal sleep cycle
+    wake_phase_end(WAKE_PHASE_SLEEP_ENTRY, sleep_entry_start_us);
+    wake_phase_end_cycle();
+    ESP_LOGI("DEEP_SLEEP", "Entering Deep Sleep");
+    esp_deep_sleep_start();
+}
 
 /**************************************
- * @brief This function checks if the power button has been held for three seconds. 
- * @returns true if it has been held for at least 3 seconds. If not, it returns false
+ * @brief Held for ten seconds and released: turn the display off and deep sleep until the power button is pressed.
+ *        This only runs on the release so the device does not instantly power back on from the held button
  **************************************/
-bool pwr_held_for_three_seconds(uint32_t press_time)
+static void pwr_btn_power_off()
 {
-    uint32_t current_time = esp_timer_get_time();
-    // While the button is still held and it has not yet been three seconds, continue delaying
-    while((gpio_get_level(PWR_BTN_PIN) == 0) && (current_time < (press_time + THREE_SECOND_HOLD)))
-    {
-        vTaskDelay(pdMS_TO_TICKS(100));
-        current_time = esp_timer_get_time();
-    }
+    ESP_LOGI(TAG, "Long Press of 10s detected, powering off");
 
-    if(current_time >= (press_time + THREE_SECOND_HOLD))
-    {
-        return true;
-    }
+    // Turn display backlight off and silence both buzzers, powering off should not leave an alarm latched on
+    power_down_display();
+    buzzer_stop(BUZZER_USER);
+    buzzer_stop(BUZZER_SAFETY);
+    vTaskDelay(pdMS_TO_TICKS(100));
 
-    return false;
-}
+    // Enable the wakeup from pressing the power button
+    esp_sleep_enable_ext0_wakeup(PWR_BTN_PIN, 0);
 
+    ESP_LOGI("DEEP_SLEEP", "Entering deep sleep until pwr button pressed");
+    esp_deep_sleep_start();
+}
 
 /******************************************
- * @brief This function determines what to do when the power button of the device is pressed
- *        It chekcs if a buzzer is currently on. If a buzzer is on, a press of this button will turn it off. 
- *        It also checks if the button has been held for either 10 seconds or 3 seconds. If either of these is true, it proceeds accordingly
+ * @brief This function determines what to do with a power button gesture. A press acknowledges any buzzer that is on.
+ *        The holds are timed by the gesture recognizer, so nothing here waits on the button: reaching 10 seconds shows
+ *        the powering down screen, and the release decides between sleep and power off. A double-click goes back
+ *        to the home screen
  ******************************************/
-void handle_pwr_btn_press()
+void handle_pwr_btn_gesture(const button_gesture_t *gesture)
 {
-    // Used in ten second and three second hold checks
-    uint32_t press_time = esp_timer_get_time();
-
-    check_if_either_buzzer_on();
-
-    if(pwr_held_for_three_seconds(press_time) && !pwr_held_for_ten_seconds(press_time)) // If held for at least three seconds and not 10, put to sleep
+    switch(gesture->type)
     {
-        power_down_display();
-        vTaskDelay(pdMS_TO_TICKS(100));
-        esp_sleep_enable_ext0_wakeup(PWR_BTN_PIN, 0);          // Wake-up from deep sleep when the power button is pressed
-        esp_sleep_enable_timer_wakeup(pdMS_TO_TICKS(5000));    // If no button wsa pressed, wake up after 5 seocnds to take measurement, then it proceeds with normal sleep cycle
-        ESP_LOGI("DEEP_SLEEP", "Entering Deep Sleep");
-        esp_deep_sleep_start();
+        case BUTTON_GESTURE_PRESS:
+            check_if_either_buzzer_on();
+            break;
+        case BUTTON_GESTURE_DOUBLE_CLICK:
+            if(is_initial_data_ready())
+            {
+                current_page = HOME_SCREEN;
+                set_ui_screen_page(current_page);
+            }
+            break;
+        case BUTTON_GESTURE_HOLD_10S:
+            set_ui_screen_page(POWERING_DOWN_SCREEN);
+            break;
+        case BUTTON_GESTURE_HOLD_3S_RELEASED:
+            pwr_btn_enter_sleep();
+            break;
+        case BUTTON_GESTURE_HOLD_10S_RELEASED:
+            pwr_btn_power_off();
+            break;
+        default:
+            break;
     }
-    else if(pwr_held_for_ten_seconds(press_time)) // If held for 10 seconds, power down
-    {
-        ESP_LOGI(TAG, "Long Press of 10s detected, powering off");
-
-        // Turn display backlight off
-        power_down_display();
-        vTaskDelay(pdMS_TO_TICKS(100));
-
-        // Enable the wakeup from pressing the power button
-        esp_sleep_enable_ext0_wakeup(PWR_BTN_PIN, 0);
-
-        esp_deep_sleep_start();
-        ESP_LOGI("DEEP_SLEEP", "Entering deep sleep until pwr button pressed");
-    }
-}
\ No newline at end of file
+}
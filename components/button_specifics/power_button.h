@@ -2,8 +2,9 @@
 #define POWER_BUTTON_H
 
 #include "stdbool.h"
+#include "button_gestures.h"
 
-void handle_pwr_btn_press();
+void handle_pwr_btn_gesture(const button_gesture_t *gesture);
 
 void reset_user_buzzer_ack();
 bool has_user_buzzer_been_acked();
@@ -0,0 +1,237 @@
+#include "display_framebuffer.h"
+#include "i2c_config.h"
+#include "string.h"
+#include "stdbool.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "freertos/FreeRTOS.h"
+
+static const char *TAG = "FRAMEBUFFER";
+
+// Unchanged characters between two changed runs are resent rather than paying for another cursor command
+#define RUN_MERGE_GAP  2
+
+// Changed runs are at least RUN_MERGE_GAP + 1 characters apart, so a row holds at most this many cursor commands.
+// A custom character takes two bytes to draw instead of one
+#define MAX_RUNS_PER_ROW         ((DISPLAY_COLUMNS + RUN_MERGE_GAP + 1) / (RUN_MERGE_GAP + 2))
+#define FRAMEBUFFER_STREAM_SIZE  (DISPLAY_ROWS * (2 * DISPLAY_COLUMNS + 2 * MAX_RUNS_PER_ROW))
+
+// Custom characters are stored in the frame as these codes, which never show up in text
+#define GLYPH_CODE_FIRST  0x01
+#define IS_GLYPH_CODE(c)  ((uint8_t)(c) >= GLYPH_CODE_FIRST && (uint8_t)(c) < GLYPH_CODE_FIRST + SERLCD_CUSTOM_CHAR_COUNT)
+
+// DDRAM address of the first column of each row on the SerLCD
+static const uint8_t row_start_address[4] = {0x00, 0x40, 0x14, 0x54};
+
+// What the screens want displayed next
+static char frame_pending[DISPLAY_ROWS][DISPLAY_COLUMNS];
+
+// What is actually on the display. The display keeps its contents through deep sleep, so this does too
+RTC_DATA_ATTR static char frame_sent[DISPLAY_ROWS][DISPLAY_COLUMNS];
+RTC_DATA_ATTR static bool frame_sent_valid = false;
+
+// Custom character bitmaps the display already has. Uploads are slow and the SerLCD saves them to its EEPROM, so a slot
+// is only rewritten when its bitmap actually changes
+RTC_DATA_ATTR static uint8_t glyph_sent[SERLCD_CUSTOM_CHAR_COUNT][SERLCD_CUSTOM_CHAR_ROWS];
+RTC_DATA_ATTR static uint8_t glyph_sent_valid_mask = 0;
+
+/**********************************
+ * @brief Blanks the whole pending frame. Screens call this before drawing so leftovers from the last page are erased
+ *********************************/
+void framebuffer_clear()
+{
+    memset(frame_pending, ' ', sizeof(frame_pending));
+}
+
+/**********************************
+ * @brief Writes text into the pending frame starting at the given position. Text past the end of the row is cut off
+ *********************************/
+void framebuffer_write_text(uint8_t row, uint8_t column, const char *text)
+{
+    if(row >= DISPLAY_ROWS)
+    {
+        return;
+    }
+    for(uint8_t col = column; col < DISPLAY_COLUMNS && *text != '\0'; col++)
+    {
+        frame_pending[row][col] = *text++;
+    }
+}
+
+/**********************************
+ * @brief Replaces a whole row of the pending frame, padding with spaces
+ *********************************/
+void framebuffer_set_line(uint8_t row, const char *text)
+{
+    if(row >= DISPLAY_ROWS)
+    {
+        return;
+    }
+    memset(frame_pending[row], ' ', DISPLAY_COLUMNS);
+    framebuffer_write_text(row, 0, text);
+}
+
+/**********************************
+ * @brief The display was just sent the clear command, so it is all spaces now
+ *********************************/
+void framebuffer_mark_display_cleared()
+{
+    memset(frame_sent, ' ', sizeof(frame_sent));
+    frame_sent_valid = true;
+}
+
+/**********************************
+ * @brief The display contents are unknown (first power on or a failed write), so the next flush redraws every character
+ *********************************/
+void framebuffer_invalidate()
+{
+    frame_sent_valid = false;
+}
+
+/**********************************
+ * @brief Places a custom character in the pending frame. The slot has to be defined with framebuffer_define_glyph first
+ *********************************/
+void framebuffer_write_glyph(uint8_t row, uint8_t column, uint8_t slot)
+{
+    if(row >= DISPLAY_ROWS || column >= DISPLAY_COLUMNS || slot >= SERLCD_CUSTOM_CHAR_COUNT)
+    {
+        return;
+    }
+    frame_pending[row][column] = GLYPH_CODE_FIRST + slot;
+}
+
+/**********************************
+ * @brief Makes sure a custom character slot holds the given bitmap, uploading it only if the display has something else
+ * @param bitmap is the 8 rows of the character, the low 5 bits of each row are the pixels
+ * @returns ESP_OK if the display has the bitmap
+ *********************************/
+esp_err_t framebuffer_define_glyph(uint8_t slot, const uint8_t bitmap[SERLCD_CUSTOM_CHAR_ROWS])
+{
+    uint8_t create_cmd[2 + SERLCD_CUSTOM_CHAR_ROWS];
+
+    if(slot >= SERLCD_CUSTOM_CHAR_COUNT)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if((glyph_sent_valid_mask & (1 << slot)) && memcmp(glyph_sent[slot], bitmap, SERLCD_CUSTOM_CHAR_ROWS) == 0)
+    {
+        return ESP_OK;
+    }
+
+    create_cmd[0] = SERLCD_SETTING_COMMAND;
+    create_cmd[1] = SERLCD_CREATE_CUSTOM_CHAR + slot;
+    memcpy(&create_cmd[2], bitmap, SERLCD_CUSTOM_CHAR_ROWS);
+
+    esp_err_t err = i2c_master_transmit(i2c_display_device_handle, create_cmd, sizeof(create_cmd), pdMS_TO_TICKS(500));
+    if(err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Error defining custom character %d: %s", slot, esp_err_to_name(err));
+        glyph_sent_valid_mask &= ~(1 << slot);
+        return err;
+    }
+
+    memcpy(glyph_sent[slot], bitmap, SERLCD_CUSTOM_CHAR_ROWS);
+    glyph_sent_valid_mask |= (1 << slot);
+
+    // A changed bitmap changes every place the slot is already drawn, so make those compare as different and redraw
+    for(uint8_t row = 0; row < DISPLAY_ROWS; row++)
+    {
+        for(uint8_t col = 0; col < DISPLAY_COLUMNS; col++)
+        {
+            if((uint8_t)frame_sent[row][col] == GLYPH_CODE_FIRST + slot)
+            {
+                frame_sent[row][col] = 0;
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+/**********************************
+ * @brief Appends one run of changed characters to the command stream: a cursor position command followed by the characters.
+ *        Custom characters are sent as the SerLCD write custom character command
+ * @returns the new length of the command stream
+ *********************************/
+static uint16_t append_run(uint8_t *stream, uint16_t length, uint8_t row, uint8_t start, uint8_t run_length)
+{
+    stream[length++] = SERLCD_SPECIAL_COMMAND;
+    stream[length++] = SERLCD_SET_DDRAM_ADDR | (row_start_address[row] + start);
+    for(uint8_t col = start; col < start + run_length; col++)
+    {
+        char c = frame_pending[row][col];
+        if(IS_GLYPH_CODE(c))
+        {
+            stream[length++] = SERLCD_SETTING_COMMAND;
+            stream[length++] = SERLCD_WRITE_CUSTOM_CHAR + ((uint8_t)c - GLYPH_CODE_FIRST);
+        }
+        else
+        {
+            stream[length++] = c;
+        }
+    }
+    return length;
+}
+
+/**********************************
+ * @brief Compares the pending frame against what is on the display and builds one command stream holding only the
+ *        characters that differ, grouped into runs. Nearby runs are merged when resending the gap is cheaper than
+ *        another cursor command. The whole stream goes out in a single transmit, so a render either lands completely
+ *        or not at all
+ * @returns ESP_OK if everything that changed was sent
+ *********************************/
+esp_err_t framebuffer_flush()
+{
+    static uint8_t command_stream[FRAMEBUFFER_STREAM_SIZE];
+    uint16_t stream_length = 0;
+    esp_err_t err = ESP_OK;
+
+    if(!frame_sent_valid)  // Unknown contents, make every character compare as different
+    {
+        memset(frame_sent, 0, sizeof(frame_sent));
+    }
+
+    for(uint8_t row = 0; row < DISPLAY_ROWS; row++)
+    {
+        uint8_t col = 0;
+        while(col < DISPLAY_COLUMNS)
+        {
+            if(frame_pending[row][col] == frame_sent[row][col])
+            {
+                col++;
+                continue;
+            }
+
+            // Extend the run up to the last changed character that is within the merge gap of the previous one
+            uint8_t start = col;
+            uint8_t end = col;
+            for(uint8_t next = col + 1; next < DISPLAY_COLUMNS && next <= end + RUN_MERGE_GAP + 1; next++)
+            {
+                if(frame_pending[row][next] != frame_sent[row][next])
+                {
+                    end = next;
+                }
+            }
+
+            stream_length = append_run(command_stream, stream_length, row, start, end - start + 1);
+            col = end + 1;
+        }
+    }
+
+    if(stream_length == 0)  // Nothing changed
+    {
+        frame_sent_valid = true;
+        return ESP_OK;
+    }
+
+    err = i2c_master_transmit(i2c_display_device_handle, command_stream, stream_length, pdMS_TO_TICKS(500));
+    if(err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Error sending frame to screen: %s", esp_err_to_name(err));
+        framebuffer_invalidate();
+        return err;
+    }
+
+    memcpy(frame_sent, frame_pending, sizeof(frame_sent));
+    frame_sent_valid = true;
+    return ESP_OK;
+}
@@ -0,0 +1,37 @@
+#ifndef DISPLAY_FRAMEBUFFER_H
+#define DISPLAY_FRAMEBUFFER_H
+
+#include "stdint.h"
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+// The display geometry is chosen in menuconfig, under IAQ Display
+#ifdef CONFIG_DISPLAY_20X4
+#define DISPLAY_ROWS     4
+#define DISPLAY_COLUMNS  20
+#else
+#define DISPLAY_ROWS     2
+#define DISPLAY_COLUMNS  16
+#endif
+
+// SerLCD command prefix for HD44780 commands, followed by set-DDRAM-address to position the cursor
+#define SERLCD_SPECIAL_COMMAND  254
+#define SERLCD_SET_DDRAM_ADDR   0x80
+
+// SerLCD setting commands for custom characters: create takes the slot plus 8 row bitmaps, write draws the slot at the cursor
+#define SERLCD_SETTING_COMMAND       0x7C
+#define SERLCD_CREATE_CUSTOM_CHAR    27
+#define SERLCD_WRITE_CUSTOM_CHAR     35
+#define SERLCD_CUSTOM_CHAR_COUNT     8
+#define SERLCD_CUSTOM_CHAR_ROWS      8
+
+void framebuffer_clear();
+void framebuffer_set_line(uint8_t row, const char *text);
+void framebuffer_write_text(uint8_t row, uint8_t column, const char *text);
+esp_err_t framebuffer_flush();
+void framebuffer_mark_display_cleared();
+void framebuffer_invalidate();
+void framebuffer_write_glyph(uint8_t row, uint8_t column, uint8_t slot);
+esp_err_t framebuffer_define_glyph(uint8_t slot, const uint8_t bitmap[SERLCD_CUSTOM_CHAR_ROWS]);
+
+#endif  // DISPLAY_FRAMEBUFFER_H
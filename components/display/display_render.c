@@ -0,0 +1,121 @@
+#include "display_render.h"
+#include "ui_screen_inits.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "ui_latency.h"
+#include "wake_lock.h"
+#include "power_mode.h"
+#include "wake_phases.h"
+
+static const char *TAG = "DISPLAY_RENDER";
+
+SemaphoreHandle_t display_mutex = NULL;
+static QueueHandle_t display_render_queue = NULL;
+
+/**********************************
+ * @brief Creates the display mutex and the render queue. This needs to run before any task that draws to the screen starts
+ *********************************/
+void display_render_init()
+{
+    display_mutex = xSemaphoreCreateMutex();
+    if(display_mutex == NULL)
+    {
+        ESP_LOGE(TAG, "Error creating display mutex");
+    }
+
+    // A single slot that gets overwritten, so a burst of page changes collapses into the last one
+    display_render_queue = xQueueCreate(1, sizeof(display_render_cmd_t));
+    if(display_render_queue == NULL)
+    {
+        ESP_LOGE(TAG, "Error creating display render queue");
+    }
+}
+
+/**********************************
+ * @brief Hands a render to the render task, replacing anything still waiting. This never blocks. If the queue could not be
+ *        created, the render is done in the calling task instead so the screen still updates
+ *********************************/
+static void queue_render(display_screen_pages_t page, bool fields_only)
+{
+    display_render_cmd_t cmd = {
+        .page = page,
+        .fields_only = fields_only,
+        .input_time_us = ui_latency_note_render_request(),
+        .request_time_us = esp_timer_get_time(),
+    };
+
+    if(display_render_queue == NULL)
+    {
+        fields_only ? render_screen_fields(page) : render_screen_page(page);
+        return;
+    }
+    xQueueOverwrite(display_render_queue, &cmd);
+}
+
+/**********************************
+ * @brief Requests the whole page be drawn
+ *********************************/
+void request_screen_render(display_screen_pages_t page)
+{
+    queue_render(page, false);
+}
+
+/**********************************
+ * @brief Requests only the values of the page be redrawn. If the page is not the one on screen by the time the render
+ *        task gets to it, the whole page is drawn
+ *********************************/
+void request_screen_field_render(display_screen_pages_t page)
+{
+    queue_render(page, true);
+}
+
+/**********************************
+ * @brief Drops a render that has not started yet. Called with the display mutex held when the display is being turned
+ *        off, so a stale page is not drawn onto the cleared screen afterwards
+ *********************************/
+void discard_pending_renders()
+{
+    if(display_render_queue != NULL)
+    {
+        xQueueReset(display_render_queue);
+    }
+}
+
+/*******************
+ * @brief Does all of the screen drawing, so the tasks asking for a page never wait on the I2C writes
+ *******************/
+void display_render_task(void *parameter)
+{
+    display_render_cmd_t cmd;
+
+    while(1)
+    {
+        if(xQueueReceive(display_render_queue, &cmd, portMAX_DELAY) == pdTRUE)
+        {
+            // The device should not go to sleep partway through sending a frame, or drop its clock between transfers
+            wake_lock_acquire(WAKE_LOCK_DISPLAY);
+            power_lock_acquire(POWER_LOCK_DISPLAY);
+            if(xSemaphoreTake(display_mutex, portMAX_DELAY) == pdTRUE)
+            {
+                int64_t start_time_us = esp_timer_get_time();
+                if(cmd.fields_only)
+                {
+                    render_screen_fields(cmd.page);
+                }
+                else
+                {
+                    render_screen_page(cmd.page);
+                }
+                xSemaphoreGive(display_mutex);
+                wake_phase_end(WAKE_PHASE_RENDER, start_time_us);
+
+                if(cmd.input_time_us != 0)  // Frame is on the display, finish timing the press that asked for it
+                {
+                    ui_latency_render_done(cmd.input_time_us, cmd.request_time_us, start_time_us);
+                }
+            }
+            power_lock_release(POWER_LOCK_DISPLAY);
+            wake_lock_release(WAKE_LOCK_DISPLAY);
+        }
+    }
+}
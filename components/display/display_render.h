@@ -0,0 +1,30 @@
+#ifndef DISPLAY_RENDER_H
+#define DISPLAY_RENDER_H
+
+#include "stdbool.h"
+#include "stdint.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "iaq_ui.h"
+
+/************************************
+ * A request for the render task. Only the latest request is kept, so producers never wait on the display
+ ***********************************/
+typedef struct {
+    display_screen_pages_t page;
+    bool fields_only;  // Only the values changed, the page's fixed text is already on screen
+    int64_t input_time_us;    // ISR time of the button press that caused this render, 0 if not from a press
+    int64_t request_time_us;
+} display_render_cmd_t;
+
+void display_render_init();
+void display_render_task(void *parameter);
+void request_screen_render(display_screen_pages_t page);
+void request_screen_field_render(display_screen_pages_t page);
+void discard_pending_renders();
+
+// Held by anything that writes to the display, so commands from different tasks are never interleaved
+extern SemaphoreHandle_t display_mutex;
+
+#endif  // DISPLAY_RENDER_H
@@ -0,0 +1,234 @@
+#include "display_state.h"
+#include "display_framebuffer.h"
+#include "display_render.h"
+#include "i2c_config.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+static const char *TAG = "DISPLAY_STATE";
+
+#define FADE_STEP_PERIOD_US  50000  // 50ms between fade steps, each one is a timer callback and an I2C write
+
+RTC_DATA_ATTR static display_state_t display_state;
+
+// Fades only run while awake, so they do not need to survive deep sleep
+static esp_timer_handle_t fade_timer = NULL;
+static uint8_t fade_from[3];
+static uint8_t fade_to[3];
+static int64_t fade_start_us = 0;
+static uint16_t fade_step_count = 0;
+
+/**********************************
+ * @brief Sends the backlight colour if it differs from what the display already has. Caller holds display_mutex
+ *********************************/
+static esp_err_t send_backlight(uint8_t red, uint8_t green, uint8_t blue)
+{
+    if(display_state.known && display_state.red == red && display_state.green == green && display_state.blue == blue)
+    {
+        return ESP_OK;
+    }
+
+    uint8_t rgb_cmd[5] = {SERLCD_SETTING_COMMAND, SERLCD_SET_RGB_BACKLIGHT, red, green, blue};
+    esp_err_t err = i2c_master_transmit(i2c_display_device_handle, rgb_cmd, sizeof(rgb_cmd), pdMS_TO_TICKS(500));
+    if(err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Error setting backlight: %s", esp_err_to_name(err));
+        display_state.known = false;  // Not sure what the display ended up with, so resend next time
+        return err;
+    }
+
+    display_state.red = red;
+    display_state.green = green;
+    display_state.blue = blue;
+    display_state.known = true;
+    return ESP_OK;
+}
+
+static void stop_fade()
+{
+    if(fade_timer != NULL && esp_timer_is_active(fade_timer))
+    {
+        esp_timer_stop(fade_timer);
+    }
+}
+
+/**********************************
+ * @brief Runs from the esp_timer task once per fade step, so no task has to loop and delay through a fade. The step is
+ *        worked out from the time since the fade started, so a step skipped because something else was using the
+ *        display, or a late timer, is caught up on the next fire and the fade still ends on time
+ *********************************/
+static void fade_timer_callback(void *arg)
+{
+    if(xSemaphoreTake(display_mutex, 0) != pdTRUE)
+    {
+        return;
+    }
+
+    int64_t fade_step = (esp_timer_get_time() - fade_start_us) / FADE_STEP_PERIOD_US;
+    if(fade_step > fade_step_count)
+    {
+        fade_step = fade_step_count;
+    }
+
+    uint8_t color[3];
+    for(uint8_t i = 0; i < 3; i++)
+    {
+        color[i] = fade_from[i] + ((int32_t)(fade_to[i] - fade_from[i]) * (int32_t)fade_step) / fade_step_count;
+    }
+    send_backlight(color[0], color[1], color[2]);
+
+    if(fade_step >= fade_step_count)
+    {
+        stop_fade();
+    }
+    xSemaphoreGive(display_mutex);
+}
+
+/**********************************
+ * @brief Creates the fade timer. On a fresh power on the display settings are unknown, so the first change is always sent
+ *********************************/
+void display_state_init()
+{
+    if(esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_UNDEFINED)
+    {
+        display_state.known = false;
+        display_state.contrast_known = false;
+    }
+
+    const esp_timer_create_args_t fade_timer_args = {
+        .callback = fade_timer_callback,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "backlight_fade",
+    };
+    if(esp_timer_create(&fade_timer_args, &fade_timer) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Error creating backlight fade timer");
+        fade_timer = NULL;
+    }
+}
+
+/**********************************
+ * @brief Sets the backlight colour straight away, cancelling any fade. Nothing is sent if the display already has it
+ *********************************/
+esp_err_t display_set_backlight(uint8_t red, uint8_t green, uint8_t blue)
+{
+    xSemaphoreTake(display_mutex, portMAX_DELAY);
+    stop_fade();
+    esp_err_t err = send_backlight(red, green, blue);
+    xSemaphoreGive(display_mutex);
+    return err;
+}
+
+/**********************************
+ * @brief Starts a fade from the current backlight colour, or sets the colour straight away if it cannot fade. Caller
+ *        holds display_mutex
+ *********************************/
+static void start_fade(uint8_t red, uint8_t green, uint8_t blue, uint32_t duration_ms)
+{
+    uint16_t step_count = (duration_ms * 1000) / FADE_STEP_PERIOD_US;
+
+    stop_fade();
+    if(fade_timer == NULL || step_count == 0 || !display_state.known)
+    {
+        send_backlight(red, green, blue);
+        return;
+    }
+
+    fade_from[0] = display_state.red;
+    fade_from[1] = display_state.green;
+    fade_from[2] = display_state.blue;
+    fade_to[0] = red;
+    fade_to[1] = green;
+    fade_to[2] = blue;
+    fade_start_us = esp_timer_get_time();
+    fade_step_count = step_count;
+    esp_timer_start_periodic(fade_timer, FADE_STEP_PERIOD_US);
+}
+
+/**********************************
+ * @brief Fades the backlight from its current colour to a new one. Returns right away, the steps are sent from a timer
+ * @param duration_ms is how long the fade takes, 0 or no fade timer sets the colour straight away
+ *********************************/
+void display_fade_backlight(uint8_t red, uint8_t green, uint8_t blue, uint32_t duration_ms)
+{
+    xSemaphoreTake(display_mutex, portMAX_DELAY);
+    start_fade(red, green, blue, duration_ms);
+    xSemaphoreGive(display_mutex);
+}
+
+/**********************************
+ * @brief Sets the display contrast, if it is not already set to this
+ *********************************/
+esp_err_t display_set_contrast(uint8_t contrast)
+{
+    esp_err_t err = ESP_OK;
+
+    xSemaphoreTake(display_mutex, portMAX_DELAY);
+    if(!display_state.contrast_known || display_state.contrast != contrast)
+    {
+        uint8_t contrast_cmd[3] = {SERLCD_SETTING_COMMAND, SERLCD_SET_CONTRAST, contrast};
+        err = i2c_master_transmit(i2c_display_device_handle, contrast_cmd, sizeof(contrast_cmd), pdMS_TO_TICKS(500));
+        display_state.contrast_known = (err == ESP_OK);
+        display_state.contrast = contrast;
+        if(err != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Error setting contrast: %s", esp_err_to_name(err));
+        }
+    }
+    xSemaphoreGive(display_mutex);
+    return err;
+}
+
+/**********************************
+ * @brief Brings the display back for the user, fading the backlight up. Does nothing if it is already on
+ *********************************/
+void display_turn_on()
+{
+    xSemaphoreTake(display_mutex, portMAX_DELAY);
+    if(!display_state.on || !display_state.known)
+    {
+        display_state.on = true;
+        start_fade(DISPLAY_ON_RED, DISPLAY_ON_GREEN, DISPLAY_ON_BLUE, DISPLAY_FADE_IN_MS);
+    }
+    xSemaphoreGive(display_mutex);
+}
+
+/**********************************
+ * @brief Clears the screen and turns the backlight off before sleep. This is done straight away rather than faded, since
+ *        the device is about to stop running. Does nothing if the display is already off
+ *********************************/
+void display_turn_off()
+{
+    xSemaphoreTake(display_mutex, portMAX_DELAY);
+    if(!display_state.on && display_state.known)
+    {
+        xSemaphoreGive(display_mutex);
+        return;
+    }
+
+    stop_fade();
+    discard_pending_renders();
+
+    uint8_t clear_cmd[2] = {SERLCD_SETTING_COMMAND, SERLCD_CLEAR_DISPLAY};
+    esp_err_t err = i2c_master_transmit(i2c_display_device_handle, clear_cmd, sizeof(clear_cmd), pdMS_TO_TICKS(500));
+    if(err == ESP_OK)
+    {
+        framebuffer_mark_display_cleared();
+    }
+    else
+    {
+        ESP_LOGE(TAG, "Error clearing display: %s", esp_err_to_name(err));
+        framebuffer_invalidate();
+    }
+    send_backlight(0, 0, 0);
+    display_state.on = false;
+    xSemaphoreGive(display_mutex);
+}
+
+// Used to skip drawing while the display is off in sleep
+bool is_display_on()
+{
+    return display_state.on;
+}
@@ -0,0 +1,43 @@
+#ifndef DISPLAY_STATE_H
+#define DISPLAY_STATE_H
+
+#include "stdint.h"
+#include "stdbool.h"
+#include "esp_err.h"
+
+// SerLCD setting commands for the backlight colour (red, green, blue 0-255 in one command) and the contrast
+#define SERLCD_SET_RGB_BACKLIGHT  0x2B
+#define SERLCD_SET_CONTRAST       0x18
+#define SERLCD_CLEAR_DISPLAY      0x2D
+
+// Backlight colour used while the device is awake. Red is the SerLCD's primary backlight
+#define DISPLAY_ON_RED    255
+#define DISPLAY_ON_GREEN  193
+#define DISPLAY_ON_BLUE   193
+
+// Length of the backlight fade when the display turns on
+#define DISPLAY_FADE_IN_MS  300
+
+/************************************
+ * What the display is currently showing, as far as its settings go. Kept in RTC memory because the display stays
+ * powered through deep sleep and keeps these settings
+ ***********************************/
+typedef struct {
+    bool    known;          // False until the first write after power on, when the display's settings are unknown
+    bool    on;             // False once the screen has been cleared and the backlight turned off for sleep
+    uint8_t red;
+    uint8_t green;
+    uint8_t blue;
+    bool    contrast_known;
+    uint8_t contrast;
+} display_state_t;
+
+void display_state_init();
+esp_err_t display_set_backlight(uint8_t red, uint8_t green, uint8_t blue);
+void display_fade_backlight(uint8_t red, uint8_t green, uint8_t blue, uint32_t duration_ms);
+esp_err_t display_set_contrast(uint8_t contrast);
+void display_turn_on();
+void display_turn_off();
+bool is_display_on();
+
+#endif  // DISPLAY_STATE_H
@@ -10,43 +10,55 @@
 #include "Userbuttons.h"
 #include "user_control.h"
 #include "esp_sleep.h"
+#include "display_render.h"
+#include "display_state.h"
+#include "alarm_rules.h"
+#include "wake_scheduler.h"
 #include <stdbool.h>
 
-uint8_t clear_display_cmd[2] = {0x7C, 0x2D};
 RTC_DATA_ATTR bool read_inital_data_on_startup = false;
 
+// Readings that could not be averaged because the sensor mutex was busy are retried after this long
+#define SENSOR_MUTEX_RETRY_MS  100
+
+static TaskHandle_t display_task_handle = NULL;
+
 /**************************************
  * @brief This function prepares the display for deep sleep and power off modes
- *        It turns all of the backlights to 0% brightness, and clears the screen
+ *        It clears the screen and turns the backlights off. The display state model skips this if it is already off
  *************************************/
 void power_down_display()
 {
-    uint8_t blue_backlight_off_cmd[2] = {0x7C, 0xBC};
-    uint8_t green_backlight_off_cmd[2] = {0x7C, 0x9E};
-    uint8_t primary_backlight_off_cmd[2] = {0x7C, 0x80};
-
-    ESP_ERROR_CHECK(i2c_master_transmit(i2c_display_device_handle, clear_display_cmd, sizeof(clear_display_cmd), pdMS_TO_TICKS(500)));
-    ESP_ERROR_CHECK(i2c_master_transmit(i2c_display_device_handle, blue_backlight_off_cmd, sizeof(blue_backlight_off_cmd), pdMS_TO_TICKS(500)));
-    ESP_ERROR_CHECK(i2c_master_transmit(i2c_display_device_handle, green_backlight_off_cmd, sizeof(green_backlight_off_cmd), pdMS_TO_TICKS(500)));
-    ESP_ERROR_CHECK(i2c_master_transmit(i2c_display_device_handle, primary_backlight_off_cmd, sizeof(primary_backlight_off_cmd), pdMS_TO_TICKS(500)));
-
-    set_display_off_in_sleep();
+    display_turn_off();
 }
 
 /**************************************
- * @brief This function sends three subseuent commands to the display when it wakes up, setting the
- *        brightness of the three different backlights, primary, blue, and green for the best readability
- *        of things displayed on the screen
+ * @brief This function fades the backlights up when the device wakes for the user, for the best readability
+ *        of things displayed on the screen. Nothing is sent if the display is already on
  **************************************/
 void power_display_on()
 {
-    uint8_t blue_backlight_on_cmd[2] = {0x7C, 210};
-    uint8_t green_backlight_on_cmd[2] = {0x7C, 180};
-    uint8_t primary_backlight_on_cmd[2] = {0x7C, 0x9D};
+    display_turn_on();
+}
 
-    ESP_ERROR_CHECK(i2c_master_transmit(i2c_display_device_handle, blue_backlight_on_cmd, sizeof(blue_backlight_on_cmd), pdMS_TO_TICKS(500)));
-    ESP_ERROR_CHECK(i2c_master_transmit(i2c_display_device_handle, green_backlight_on_cmd, sizeof(green_backlight_on_cmd), pdMS_TO_TICKS(500)));
-    ESP_ERROR_CHECK(i2c_master_transmit(i2c_display_device_handle, primary_backlight_on_cmd, sizeof(primary_backlight_on_cmd), pdMS_TO_TICKS(500)));
+/**************************************
+ * @brief Turns the display on for the user and shows the startup screen until the first data is in, then the
+ *        home screen
+ **************************************/
+void show_display_for_user()
+{
+    power_display_on();
+    vTaskDelay(pdMS_TO_TICKS(1000));  // Allow time for display to show its brightnesses before sending string
+
+    // On fresh startup, display taking initial measurements
+    if(!read_inital_data_on_startup)
+    {
+        set_ui_screen_page(STARTUP_SCREEN);
+    }
+    else if(check_recent_user_interaction())  // initial data taken, device is awake
+    {
+        set_ui_screen_page(HOME_SCREEN);
+    }
 }
 
 /****************************************
@@ -59,18 +71,58 @@ display_screen_pages_t get_next_screen_page(display_screen_pages_t displayed_pag
     display_screen_pages_t next_screen = STARTUP_SCREEN;
     switch(displayed_page)
     {
+#ifdef CONFIG_DISPLAY_20X4
+        // The dashboard already shows every metric, so only the pages it does not cover follow it
+        case STARTUP_SCREEN:
+            next_screen = DASHBOARD_SCREEN;
+            break;
+        case DASHBOARD_SCREEN:
+            next_screen = DERIVED_METRICS_SCREEN;
+            break;
+        case DERIVED_METRICS_SCREEN:
+            next_screen = TEMPERATURE_TREND_SCREEN;
+            break;
+        case TEMPERATURE_TREND_SCREEN:
+            next_screen = HUMIDITY_TREND_SCREEN;
+            break;
+        case HUMIDITY_TREND_SCREEN:
+            next_screen = CO2_TREND_SCREEN;
+            break;
+        case CO2_TREND_SCREEN:
+            next_screen = VOC_TREND_SCREEN;
+            break;
+        case VOC_TREND_SCREEN:
+            next_screen = DASHBOARD_SCREEN;
+            break;
+#else
         case STARTUP_SCREEN:
             next_screen = TEMPERATURE_HUMIDITY_SCREEN;
             break;
         case TEMPERATURE_HUMIDITY_SCREEN:
+            next_screen = TEMPERATURE_TREND_SCREEN;
+            break;
+        case TEMPERATURE_TREND_SCREEN:
+            next_screen = HUMIDITY_TREND_SCREEN;
+            break;
+        case HUMIDITY_TREND_SCREEN:
+            next_screen = DERIVED_METRICS_SCREEN;
+            break;
+        case DERIVED_METRICS_SCREEN:
             next_screen = CO2_SCREEN;
             break;
         case CO2_SCREEN:
+            next_screen = CO2_TREND_SCREEN;
+            break;
+        case CO2_TREND_SCREEN:
             next_screen = VOC_SCREEN;
             break;
         case VOC_SCREEN:
+            next_screen = VOC_TREND_SCREEN;
+            break;
+        case VOC_TREND_SCREEN:
             next_screen = TEMPERATURE_HUMIDITY_SCREEN;
             break;
+#endif
         // if on threshold screens, do nothing
         case SET_CO2_THRESH_SCREEN:
             next_screen = SET_CO2_THRESH_SCREEN;
@@ -86,36 +138,13 @@ display_screen_pages_t get_next_screen_page(display_screen_pages_t displayed_pag
 }
 
 /*************************************************
- * @brief This function is used to set the screen based on what the current page is. Depending on the current page, 
- *        the corresponding function is called with the proper strings to display
+ * @brief This function is used to set the screen based on what the current page is. The page's text and values
+ *        come from the screen table in ui_screen_inits.c. The drawing is done by the render task, so this returns right away
  * @param set_page is the page that will be displayed on the screen when this function is called
  *************************************************/
 void set_ui_screen_page(display_screen_pages_t set_page)
 {
-    switch(set_page)
-    {
-        case STARTUP_SCREEN:
-            startup_screen_init();
-            break;
-        case TEMPERATURE_HUMIDITY_SCREEN:
-            temp_humid_screen_init();
-            break;
-        case CO2_SCREEN:
-            co2_screen_init();
-            break;
-        case VOC_SCREEN:
-            voc_screen_init();
-            break;
-        case SET_CO2_THRESH_SCREEN:
-            set_co2_thresh_screen_init();
-            break;
-        case SET_VOC_THRESH_SCREEN:
-            set_voc_thresh_screen_init();
-            break;
-        default:
-            error_screen_init();
-            break;
-    }
+    request_screen_render(set_page);
 }
 
 // This function is used to prevent moving off the Startup Screen before any data is ready on initial startup
@@ -135,69 +164,112 @@ bool is_initial_data_ready()
  * @param sensor_name is a character string for which sensor is being worked with. This is needed so that upon first startup, once the CO2 sensor is averaged, it will 
  *                    move from the startup screen to the CO2 screen and then the user can interact with the device from there
  * @param sensor_data_screen is the screen related to the sensor where it displays its average value
+ * @param sensor_trend_screen is the screen with the sensor's sparkline, it is refreshed along with the value screen
+ * @param retry is set if the readings are ready but the mutex was busy, so they have to be processed again later
+ * @returns true if a new average was published
  ********************************************************/
-void process_sensor_data(uint16_t *sensor_readings, uint8_t *reading_index, uint16_t *average_value ,SemaphoreHandle_t sensor_mutex, const char *sensor_name, uint8_t sensor_data_screen)
+bool process_sensor_data(uint16_t *sensor_readings, uint8_t *reading_index, uint16_t *average_value ,SemaphoreHandle_t sensor_mutex, const char *sensor_name, uint8_t sensor_data_screen, uint8_t sensor_trend_screen, bool *retry)
 {
+    bool published = false;
+
     if(*reading_index >= MAX_SENSOR_READINGS)  // if sensor has taken 10 readings, proceed
     {
         if(xSemaphoreTake(sensor_mutex, pdMS_TO_TICKS(20)) == pdTRUE)
         {
             *average_value = get_average_sensor_data(sensor_readings, reading_index, sensor_name); 
-            if(current_page == sensor_data_screen && !is_display_off_in_consistent_sleep())  // If the device is awake and the current displayed page is the one of this sensor, update value
+            published = true;
+            // If the device is awake and the current displayed page shows this sensor, update only its values
+            if((current_page == sensor_data_screen || current_page == sensor_trend_screen || current_page == DASHBOARD_SCREEN) && is_display_on())
             {
-                set_ui_screen_page(current_page);
+                request_screen_field_render(current_page);
             }
 
             if(!strcmp(sensor_name, "CO2"))  // The CO2 sensor takes the longest to get to 10 readings so on initial startup, if the CO2 sensor is being averaged, change from startup screen to CO2 screen
             {
                 if(!read_inital_data_on_startup)
                 {
-                    current_page = CO2_SCREEN;
+                    current_page = HOME_SCREEN;
                     set_ui_screen_page(current_page);
                 }
                 read_inital_data_on_startup = true;
+                wake_scheduler_end_warm_up();
             }
 
             xSemaphoreGive(sensor_mutex);
         }
+        else
+        {
+            *retry = true;
+        }
+    }
+    return published;
+}
+
+/********************************************************
+ * @brief Wakes the display task. The sensor tasks call this once a sensor has 10 readings, and the buttons call it when
+ *        a threshold changes or an alarm is acknowledged. Does nothing before the display task has started, it
+ *        checks everything once when it starts
+ * @param bits are DISPLAY_NOTIFY_ bits saying what happened
+ ********************************************************/
+void notify_display_task(uint32_t bits)
+{
+    if(display_task_handle != NULL)
+    {
+        xTaskNotify(display_task_handle, bits, eSetBits);
     }
 }
 
 
 /*******************
- * @brief The main task for the display. This will read from the data queues of the sensors and display it on the UI
+ * @brief The main task for the display. This will read from the data queues of the sensors and display it on the UI.
+ *        It sleeps until it is notified, averages whichever sensors are ready, and evaluates the alarms only when a
+ *        new average was published or an alarm input changed. A rule waiting out its minimum duration also wakes it
+ *        when that time is up, so the rule trips on time and not at the next average
  *******************/
 void display_task(void *parameter)
 {
-    // If the device is first turning on, or woken by user button press, make sure it is at the correct brightness
+    display_task_handle = xTaskGetCurrentTaskHandle();
+
+    // If the device is first turning on, or woken by user button press, make sure it is at the correct brightness.
+    // On a timer wake the display stays off and is not set up, so this task only averages readings and runs the alarms
     esp_sleep_wakeup_cause_t wakeup_reason = esp_sleep_get_wakeup_cause();
     if(wakeup_reason == ESP_SLEEP_WAKEUP_UNDEFINED || wakeup_reason == ESP_SLEEP_WAKEUP_EXT0)
     {
-       power_display_on();
-       set_backlight_updated(); // Avoid setting the brightness multiple times
+        show_display_for_user();
     }
-    vTaskDelay(pdMS_TO_TICKS(1000));  // Allow time for display to show its brightnesses before sending string
-
-   // On fresh startup, display taking initial measurements
-   if(!read_inital_data_on_startup)
-   {
-    set_ui_screen_page(STARTUP_SCREEN);
-   }
-   else if(read_inital_data_on_startup && check_recent_user_interaction())  // initial data taken, device is awake
-   {
-    set_ui_screen_page(CO2_SCREEN);
-   }
 
+    // Readings may have filled up before the handle was set, so go through everything once without waiting
+    uint32_t notified = DISPLAY_NOTIFY_READINGS_READY | DISPLAY_NOTIFY_ALARM_INPUTS;
+    bool retry = false;
     while(1)
     {
-        // Get most recent average value from all sensors
-        process_sensor_data(sensor_data_buffer.co2_concentration, &sensor_data_buffer.co2_reading_index, &sensor_data_buffer.average_co2, co2_mutex, "CO2", CO2_SCREEN);
-        process_sensor_data(sensor_data_buffer.temperature, &sensor_data_buffer.temp_reading_index, &sensor_data_buffer.average_temp, temp_humid_mutex, "TEMP", TEMPERATURE_HUMIDITY_SCREEN);
-        process_sensor_data(sensor_data_buffer.humidity, &sensor_data_buffer.humid_reading_index, &sensor_data_buffer.average_humidity, temp_humid_mutex, "HUMID", TEMPERATURE_HUMIDITY_SCREEN);
-        process_sensor_data(sensor_data_buffer.voc_measurement, &sensor_data_buffer.voc_reading_index, &sensor_data_buffer.average_voc, voc_mutex, "VOC", VOC_SCREEN);
-       
-        check_user_threshold();
-        check_general_safety_value();
-        vTaskDelay(pdMS_TO_TICKS(50));
+        bool published = false;
+        if((notified & DISPLAY_NOTIFY_READINGS_READY) || retry)
+        {
+            retry = false;
+            // Get most recent average value from all sensors that are ready
+            published |= process_sensor_data(sensor_data_buffer.co2_concentration, &sensor_data_buffer.co2_reading_index, &sensor_data_buffer.average_co2, co2_mutex, "CO2", CO2_SCREEN, CO2_TREND_SCREEN, &retry);
+            published |= process_sensor_data(sensor_data_buffer.temperature, &sensor_data_buffer.temp_reading_index, &sensor_data_buffer.average_temp, temp_humid_mutex, "TEMP", TEMPERATURE_HUMIDITY_SCREEN, TEMPERATURE_TREND_SCREEN, &retry);
+            published |= process_sensor_data(sensor_data_buffer.humidity, &sensor_data_buffer.humid_reading_index, &sensor_data_buffer.average_humidity, temp_humid_mutex, "HUMID", TEMPERATURE_HUMIDITY_SCREEN, HUMIDITY_TREND_SCREEN, &retry);
+            published |= process_sensor_data(sensor_data_buffer.voc_measurement, &sensor_data_buffer.voc_reading_index, &sensor_data_buffer.average_voc, voc_mutex, "VOC", VOC_SCREEN, VOC_TREND_SCREEN, &retry);
+        }
+
+        if(published || (notified & DISPLAY_NOTIFY_ALARM_INPUTS))
+        {
+            alarm_rules_evaluate();
+        }
+
+        TickType_t wait = retry ? pdMS_TO_TICKS(SENSOR_MUTEX_RETRY_MS) : portMAX_DELAY;
+        uint32_t pending_ms = get_ms_until_alarm_pending_due();
+        if(pending_ms != UINT32_MAX && pdMS_TO_TICKS(pending_ms) < wait)
+        {
+            wait = pdMS_TO_TICKS(pending_ms);
+        }
+
+        notified = 0;
+        if(xTaskNotifyWait(0, UINT32_MAX, &notified, wait) != pdTRUE && pending_ms != UINT32_MAX)
+        {
+            notified = DISPLAY_NOTIFY_ALARM_INPUTS;  // Timed out for a pending rule
+        }
     }
 }
@@ -3,10 +3,14 @@
 
 #include "stdint.h"
 #include "stdbool.h"
+#include "sdkconfig.h"
 
-extern uint8_t clear_display_cmd[2];
+// Task notification bits that wake the display task
+#define DISPLAY_NOTIFY_READINGS_READY  (1 << 0)  // A sensor has 10 readings waiting to be averaged
+#define DISPLAY_NOTIFY_ALARM_INPUTS    (1 << 1)  // A threshold changed, an alarm was acknowledged or a reading came in
 
 void display_task(void *parameter);
+void notify_display_task(uint32_t bits);
 
 /************************************
  * These are all the possible screen pages that can be used
@@ -14,20 +18,37 @@ void display_task(void *parameter);
 typedef enum {
     STARTUP_SCREEN = 0,
     TEMPERATURE_HUMIDITY_SCREEN,
+    TEMPERATURE_TREND_SCREEN,
+    HUMIDITY_TREND_SCREEN,
+    DERIVED_METRICS_SCREEN,
     CO2_SCREEN,
+    CO2_TREND_SCREEN,
     VOC_SCREEN,
+    VOC_TREND_SCREEN,
+    DASHBOARD_SCREEN,    // All four metrics at once, only on the 20x4 display
 
     // Settings Screens
     SET_CO2_THRESH_SCREEN,
     SET_VOC_THRESH_SCREEN,
-    ERROR_SCREEN
+    POWERING_DOWN_SCREEN,
+    ERROR_SCREEN,
+
+    SCREEN_PAGE_COUNT
 } display_screen_pages_t;
 
+// The page the device returns to once data is ready or it is woken up. The 20x4 display fits everything on the dashboard
+#ifdef CONFIG_DISPLAY_20X4
+#define HOME_SCREEN  DASHBOARD_SCREEN
+#else
+#define HOME_SCREEN  CO2_SCREEN
+#endif
+
 display_screen_pages_t get_next_screen_page(display_screen_pages_t displayed_page);
 void set_ui_screen_page(display_screen_pages_t setpage);
 bool is_initial_data_ready();
 
 void power_display_on();
+void show_display_for_user();
 void power_down_display();
 
 extern display_screen_pages_t current_page;
@@ -0,0 +1,98 @@
+#include "sparkline.h"
+#include "sensor_statistics.h"
+#include "string.h"
+
+/**********************************
+ * @brief Averages the history down to at most one value per column. Each column covers an equal share of the samples,
+ *        with fewer samples than columns each sample gets its own column
+ * @returns the number of columns filled
+ *********************************/
+static uint8_t downsample_history(const uint16_t *history, uint8_t history_count, uint16_t *columns)
+{
+    uint8_t column_count = (history_count < SPARKLINE_COLUMNS) ? history_count : SPARKLINE_COLUMNS;
+
+    for(uint8_t col = 0; col < column_count; col++)
+    {
+        uint8_t first = (col * history_count) / column_count;
+        uint8_t last = ((col + 1) * history_count) / column_count;
+        uint32_t sum = 0;
+        for(uint8_t i = first; i < last; i++)
+        {
+            sum += history[i];
+        }
+        columns[col] = (uint16_t)((sum + (last - first) / 2) / (last - first));
+    }
+    return column_count;
+}
+
+/**********************************
+ * @brief Builds the sparkline for a metric from its statistics window. The bars are scaled to the low and high of the
+ *        downsampled values, so a flat history draws as a row of the shortest bar
+ * @param metric is which quantity to draw
+ * @param sparkline is used as an output parameter
+ * @returns false if the metric has no history yet
+ *********************************/
+bool build_sparkline(sensor_metric_t metric, sparkline_t *sparkline)
+{
+    uint16_t history[STATS_WINDOW_SIZE];
+    uint16_t columns[SPARKLINE_COLUMNS];
+
+    memset(sparkline, 0, sizeof(*sparkline));
+
+    uint8_t history_count = sensor_stats_get_history(metric, history, STATS_WINDOW_SIZE);
+    if(history_count == 0)
+    {
+        return false;
+    }
+
+    uint8_t column_count = downsample_history(history, history_count, columns);
+    uint16_t low = columns[0];
+    uint16_t high = columns[0];
+    for(uint8_t col = 1; col < column_count; col++)
+    {
+        low = (columns[col] < low) ? columns[col] : low;
+        high = (columns[col] > high) ? columns[col] : high;
+    }
+
+    // Right align so the newest value is always in the last column
+    uint8_t offset = SPARKLINE_COLUMNS - column_count;
+    for(uint8_t col = 0; col < column_count; col++)
+    {
+        uint32_t span = high - low;
+        uint8_t level = 1;
+        if(span > 0)
+        {
+            level = 1 + (uint8_t)(((uint32_t)(columns[col] - low) * (SPARKLINE_LEVELS - 1) + span / 2) / span);
+        }
+        sparkline->level[offset + col] = level;
+    }
+
+    sparkline->column_count = column_count;
+    sparkline->low = low;
+    sparkline->high = high;
+    return true;
+}
+
+/**********************************
+ * @brief Makes sure the display holds one bar character per level. The bitmaps never change, so after the first upload
+ *        this sends nothing
+ *********************************/
+esp_err_t define_sparkline_glyphs()
+{
+    uint8_t bitmap[SERLCD_CUSTOM_CHAR_ROWS];
+
+    for(uint8_t level = 1; level <= SPARKLINE_LEVELS; level++)
+    {
+        for(uint8_t row = 0; row < SERLCD_CUSTOM_CHAR_ROWS; row++)
+        {
+            bitmap[row] = (row >= SERLCD_CUSTOM_CHAR_ROWS - level) ? 0x1F : 0x00;
+        }
+
+        esp_err_t err = framebuffer_define_glyph(level - 1, bitmap);
+        if(err != ESP_OK)
+        {
+            return err;
+        }
+    }
+    return ESP_OK;
+}
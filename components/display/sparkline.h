@@ -0,0 +1,27 @@
+#ifndef SPARKLINE_H
+#define SPARKLINE_H
+
+#include "stdint.h"
+#include "stdbool.h"
+#include "esp_err.h"
+#include "general_sensors.h"
+#include "display_framebuffer.h"
+
+#define SPARKLINE_COLUMNS  DISPLAY_COLUMNS
+// One custom character per bar height, from one pixel row up to the full character
+#define SPARKLINE_LEVELS   SERLCD_CUSTOM_CHAR_COUNT
+
+/************************************
+ * A metric's recent history squeezed into one row of bars. Level 1 is the window low, SPARKLINE_LEVELS the window high
+ ***********************************/
+typedef struct {
+    uint8_t  column_count;                // Columns with data, right aligned so the newest is always in the last column
+    uint8_t  level[SPARKLINE_COLUMNS];
+    uint16_t low;
+    uint16_t high;
+} sparkline_t;
+
+bool build_sparkline(sensor_metric_t metric, sparkline_t *sparkline);
+esp_err_t define_sparkline_glyphs();
+
+#endif  // SPARKLINE_H
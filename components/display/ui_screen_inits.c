@@ -1,202 +1,479 @@
 #include "ui_screen_inits.h"
 #include "iaq_ui.h"
-#include "driver/i2c.h"
-#include "i2c_config.h"
 #include "esp_err.h"
 #include "esp_log.h"
 #include "string.h"
-#include "get_sensor_data.h"
 #include "general_sensors.h"
-#include "co2_sensor.h"
-#include "voc_sensor.h"
-#include "temp_sensor.h"
+#include "derived_metrics.h"
+#include "co2_trend.h"
+#include "co2_ventilation.h"
+#include "display_framebuffer.h"
+#include "sparkline.h"
 
 static const char *TAG = "DISPLAY";
 
-char display_text_buf_line1[16];
-char display_text_buf_line2[16];
-char display_text_buf_line3[16];
-char display_text_buf_line4[16];
-uint8_t cursor_to_second_row_cmd[2] = {254, 128+64};
+// Shown in place of a value that does not fit in its field
+#define FIELD_OVERFLOW_CHAR  '#'
+
+// Where a trend page shows the range its bars are scaled to, e.g. "CO2   412- 1200"
+#define SPARKLINE_LOW_COLUMN   4
+#define SPARKLINE_HIGH_COLUMN  10
+#define SPARKLINE_RANGE_WIDTH  5
 
 /**********************************
- * @brief Clears out all of the text buffers
+ * @brief Writes an integer into exactly width characters, right aligned and padded with spaces. With decimals set,
+ *        the value is treated as scaled by 10^decimals and a decimal point is inserted. No sprintf, no allocation
+ * @param dest must hold width + 1 characters, it is always NUL terminated
  *********************************/
-void reset_text_buffers()
+static void format_fixed_width(char *dest, int32_t value, uint8_t width, uint8_t decimals)
 {
-    memset(display_text_buf_line1, 0, sizeof(display_text_buf_line1));
-    memset(display_text_buf_line2, 0, sizeof(display_text_buf_line2));
-    memset(display_text_buf_line3, 0, sizeof(display_text_buf_line3));
-    memset(display_text_buf_line4, 0, sizeof(display_text_buf_line4));
-}
+    bool negative = value < 0;
+    uint32_t magnitude = negative ? (uint32_t)(-(int64_t)value) : (uint32_t)value;
+    int8_t pos = width - 1;
+    uint8_t digits = 0;
 
-/*********************************
- * @brief Sends command to display to clear the screen, checks if command successfylly received
- ********************************/
-void clear_display_screen()
-{
-    esp_err_t err = ESP_FAIL;
-    err = i2c_master_transmit(i2c_display_device_handle, clear_display_cmd, sizeof(clear_display_cmd), pdMS_TO_TICKS(500));
-    if(err != ESP_OK)
+    dest[width] = '\0';
+
+    // Emit digits from the right, always at least one digit in front of the decimal point
+    while(pos >= 0 && (magnitude > 0 || digits <= decimals))
     {
-        ESP_LOGE(TAG, "Error clearing the screen");
+        if(decimals > 0 && digits == decimals)
+        {
+            dest[pos--] = '.';
+            if(pos < 0)
+            {
+                break;
+            }
+        }
+        dest[pos--] = '0' + (magnitude % 10);
+        magnitude /= 10;
+        digits++;
     }
-}
 
-/*********************************
- * @brief Sends command to display to set the curso to the second row, posiiton "0"
- ********************************/
-void move_cursor_to_second_row()
-{
-    esp_err_t err = ESP_FAIL;
-    err = i2c_master_transmit(i2c_display_device_handle, cursor_to_second_row_cmd, sizeof(cursor_to_second_row_cmd), pdMS_TO_TICKS(500));
-    if(err != ESP_OK)
+    if(negative && pos >= 0)
+    {
+        dest[pos--] = '-';
+        negative = false;
+    }
+
+    if(magnitude > 0 || digits <= decimals || negative)  // Ran out of room
+    {
+        memset(dest, FIELD_OVERFLOW_CHAR, width);
+        return;
+    }
+
+    while(pos >= 0)
     {
-        ESP_LOGE(TAG, "Error moving cursor to second row");
+        dest[pos--] = ' ';
     }
 }
 
-void startup_screen_init()
+/**********************************
+ * Field getters. Each reads one value out of the sensor data for a screen, returning false if there is nothing to show
+ *********************************/
+static bool get_average_temp(int32_t *value)
+{
+    *value = sensor_data_buffer.average_temp;
+    return true;
+}
+
+static bool get_average_humidity(int32_t *value)
+{
+    *value = sensor_data_buffer.average_humidity;
+    return true;
+}
+
+static bool get_average_co2(int32_t *value)
 {
-    clear_display_screen();
-    reset_text_buffers();
-    snprintf(display_text_buf_line1, sizeof(display_text_buf_line1), "Taking initial");
-    snprintf(display_text_buf_line2, sizeof(display_text_buf_line2), "measurements");
-    
-    ESP_ERROR_CHECK(i2c_master_transmit(i2c_display_device_handle, (uint8_t *)display_text_buf_line1, strlen(display_text_buf_line1), pdMS_TO_TICKS(500)));
-    move_cursor_to_second_row();
-    ESP_ERROR_CHECK(i2c_master_transmit(i2c_display_device_handle, (uint8_t *)display_text_buf_line2, strlen(display_text_buf_line2), pdMS_TO_TICKS(500)));
+    *value = sensor_data_buffer.average_co2;
+    return true;
+}
 
+static bool get_average_voc(int32_t *value)
+{
+    *value = sensor_data_buffer.average_voc;
+    return true;
 }
 
-void temp_humid_screen_init()
+static bool get_co2_user_threshold(int32_t *value)
 {
-    esp_err_t err = ESP_FAIL;
-    clear_display_screen();
+    *value = sensor_data_buffer.co2_user_threshold;
+    return true;
+}
 
-    reset_text_buffers();
-    sprintf(display_text_buf_line1, "Temp: %dF", sensor_data_buffer.average_temp);
-    sprintf(display_text_buf_line2, "Humid: %d%%rH", sensor_data_buffer.average_humidity);
+static bool get_voc_user_threshold(int32_t *value)
+{
+    *value = sensor_data_buffer.voc_user_threshold;
+    return true;
+}
 
-    err = i2c_master_transmit(i2c_display_device_handle, (uint8_t *)display_text_buf_line1, strlen(display_text_buf_line1), pdMS_TO_TICKS(500));
-    if(err != ESP_OK)
+// Derived metrics are kept in tenths, round to the nearest whole number for the screen
+static int32_t round_tenths(int32_t value)
+{
+    return (value >= 0) ? (value + 5) / 10 : (value - 5) / 10;
+}
+
+static bool get_dew_point(int32_t *value)
+{
+    derived_metrics_t metrics;
+    if(!get_derived_metrics(&metrics))
     {
-        ESP_LOGE(TAG, "Error sending temperature string to screen");
+        return false;
     }
+    *value = round_tenths(metrics.dew_point_f10);
+    return true;
+}
 
-    move_cursor_to_second_row();
-
-    err = i2c_master_transmit(i2c_display_device_handle, (uint8_t *)display_text_buf_line2, strlen(display_text_buf_line2), pdMS_TO_TICKS(500));
-    if(err != ESP_OK)
+static bool get_heat_index(int32_t *value)
+{
+    derived_metrics_t metrics;
+    if(!get_derived_metrics(&metrics))
     {
-        ESP_LOGE(TAG, "Error sending humidity string to screen");
+        return false;
     }
+    *value = round_tenths(metrics.heat_index_f10);
+    return true;
 }
 
-void co2_screen_init()
+static bool get_absolute_humidity_tenths(int32_t *value)
 {
-    esp_err_t err = ESP_FAIL;
+    derived_metrics_t metrics;
+    if(!get_derived_metrics(&metrics))
+    {
+        return false;
+    }
+    *value = metrics.absolute_humidity_x100 / 10;
+    return true;
+}
 
-    clear_display_screen();
+static bool get_minutes_to_user_threshold(int32_t *value)
+{
+    *value = get_co2_minutes_to_user_threshold();
+    return *value > 0;
+}
 
-    reset_text_buffers();
-    sprintf(display_text_buf_line1, "CO2: %d ppm", sensor_data_buffer.average_co2);
+static bool get_minutes_to_safety_threshold(int32_t *value)
+{
+    *value = get_co2_minutes_to_safety_threshold();
+    return *value > 0;
+}
 
-    err = i2c_master_transmit(i2c_display_device_handle, (uint8_t *)display_text_buf_line1, strlen(display_text_buf_line1), pdMS_TO_TICKS(500));
-    if(err != ESP_OK)
+static bool get_air_changes_x100(int32_t *value)
+{
+    uint16_t air_changes_x100 = 0;
+    if(!get_ventilation_rate(&air_changes_x100))
     {
-        ESP_LOGE(TAG, "Error sending CO2 string to screen: 0x%03X", err);
+        return false;
     }
+    *value = air_changes_x100;
+    return true;
 }
 
-void voc_screen_init()
+/**********************************
+ * Layout selectors, for screens whose fixed text changes with the data
+ *********************************/
+enum {
+    DERIVED_LAYOUT_VALUES = 0,
+    DERIVED_LAYOUT_NO_DATA
+};
+
+static uint8_t select_derived_metrics_layout()
 {
-    esp_err_t err = ESP_FAIL;
+    derived_metrics_t metrics;
+    return get_derived_metrics(&metrics) ? DERIVED_LAYOUT_VALUES : DERIVED_LAYOUT_NO_DATA;
+}
+
+enum {
+    CO2_LAYOUT_PLAIN = 0,
+    CO2_LAYOUT_USER_LIMIT,
+    CO2_LAYOUT_UNSAFE,
+    CO2_LAYOUT_VENTILATION
+};
 
-    clear_display_screen(); 
-    reset_text_buffers();
+// If CO2 is rising, warn how long until the buzzer would go off so the user can ventilate first.
+// When it is not rising, show how well the room is ventilated instead
+static uint8_t select_co2_layout()
+{
+    int32_t minutes_to_user_threshold = get_co2_minutes_to_user_threshold();
+    int32_t value = 0;
 
-    sprintf(display_text_buf_line1, "VOC Level:");
-    sprintf(display_text_buf_line2, "%d ppb", sensor_data_buffer.average_voc);
-    err = i2c_master_transmit(i2c_display_device_handle, (uint8_t *)display_text_buf_line1, strlen(display_text_buf_line1), pdMS_TO_TICKS(500));
-    if(err != ESP_OK)
+    if(minutes_to_user_threshold > 0)
     {
-        ESP_LOGE(TAG, "Error sending VOC string to screen");
+        return CO2_LAYOUT_USER_LIMIT;
     }
-
-    move_cursor_to_second_row();
-
-    err = i2c_master_transmit(i2c_display_device_handle, (uint8_t *)display_text_buf_line2, strlen(display_text_buf_line2), pdMS_TO_TICKS(500));
-    if(err != ESP_OK)
+    if(minutes_to_user_threshold == 0 && get_minutes_to_safety_threshold(&value))
     {
-        ESP_LOGE(TAG, "Error sending humidity string to screen");
+        return CO2_LAYOUT_UNSAFE;
     }
+    if(get_air_changes_x100(&value))
+    {
+        return CO2_LAYOUT_VENTILATION;
+    }
+    return CO2_LAYOUT_PLAIN;
 }
 
-void set_powering_down_screen()
+/**********************************
+ * Screen table. The fixed text of each layout leaves spaces where its fields are drawn
+ *********************************/
+static const screen_layout_t startup_layouts[] = {
+    {.text = {"Taking initial", "measurements"}},
+};
+
+static const screen_field_t temp_humid_fields[] = {
+    {.row = 0, .column = 6, .width = 3, .get_value = get_average_temp},
+    {.row = 1, .column = 7, .width = 3, .get_value = get_average_humidity},
+};
+static const screen_layout_t temp_humid_layouts[] = {
+    {.text = {"Temp:    F", "Humid:    %rH"}, .fields = temp_humid_fields, .field_count = 2},
+};
+
+static const screen_field_t derived_metrics_fields[] = {
+    {.row = 0, .column = 4,  .width = 3, .get_value = get_dew_point},
+    {.row = 0, .column = 12, .width = 3, .get_value = get_heat_index},
+    {.row = 1, .column = 5,  .width = 4, .decimals = 1, .get_value = get_absolute_humidity_tenths},
+};
+static const screen_layout_t derived_metrics_layouts[] = {
+    [DERIVED_LAYOUT_VALUES]  = {.text = {"Dew    F HI    F", "AbsH      g/m3"}, .fields = derived_metrics_fields, .field_count = 3},
+    [DERIVED_LAYOUT_NO_DATA] = {.text = {"Dew point:", "No data yet"}},
+};
+
+#define CO2_READING_FIELD  {.row = 0, .column = 5, .width = 5, .get_value = get_average_co2}
+static const screen_field_t co2_plain_fields[] = {
+    CO2_READING_FIELD,
+};
+static const screen_field_t co2_user_limit_fields[] = {
+    CO2_READING_FIELD,
+    {.row = 1, .column = 7, .width = 3, .get_value = get_minutes_to_user_threshold},
+};
+static const screen_field_t co2_unsafe_fields[] = {
+    CO2_READING_FIELD,
+    {.row = 1, .column = 8, .width = 3, .get_value = get_minutes_to_safety_threshold},
+};
+static const screen_field_t co2_ventilation_fields[] = {
+    CO2_READING_FIELD,
+    {.row = 1, .column = 5, .width = 5, .decimals = 2, .get_value = get_air_changes_x100},
+};
+static const screen_layout_t co2_layouts[] = {
+    [CO2_LAYOUT_PLAIN]       = {.text = {"CO2:       ppm", ""},                .fields = co2_plain_fields,       .field_count = 1},
+    [CO2_LAYOUT_USER_LIMIT]  = {.text = {"CO2:       ppm", "Limit ~    min"},  .fields = co2_user_limit_fields,  .field_count = 2},
+    [CO2_LAYOUT_UNSAFE]      = {.text = {"CO2:       ppm", "Unsafe ~    min"}, .fields = co2_unsafe_fields,      .field_count = 2},
+    [CO2_LAYOUT_VENTILATION] = {.text = {"CO2:       ppm", "Vent       ACH"},  .fields = co2_ventilation_fields, .field_count = 2},
+};
+
+static const screen_field_t voc_fields[] = {
+    {.row = 1, .column = 0, .width = 5, .get_value = get_average_voc},
+};
+static const screen_layout_t voc_layouts[] = {
+    {.text = {"VOC Level:", "      ppb"}, .fields = voc_fields, .field_count = 1},
+};
+
+static const screen_field_t co2_thresh_fields[] = {
+    {.row = 1, .column = 3, .width = 4, .get_value = get_co2_user_threshold},
+};
+static const screen_layout_t co2_thresh_layouts[] = {
+    {.text = {"CO2 Thresh:", "        ppm"}, .fields = co2_thresh_fields, .field_count = 1},
+};
+
+static const screen_field_t voc_thresh_fields[] = {
+    {.row = 1, .column = 3, .width = 4, .get_value = get_voc_user_threshold},
+};
+static const screen_layout_t voc_thresh_layouts[] = {
+    {.text = {"VOC Thresh:", "        ppb"}, .fields = voc_thresh_fields, .field_count = 1},
+};
+
+static const screen_layout_t temp_trend_layouts[] = {
+    {.text = {"Temp     -", ""}, .has_sparkline = true, .sparkline_metric = SENSOR_METRIC_TEMPERATURE},
+};
+
+static const screen_layout_t humidity_trend_layouts[] = {
+    {.text = {"Hum      -", ""}, .has_sparkline = true, .sparkline_metric = SENSOR_METRIC_HUMIDITY},
+};
+
+static const screen_layout_t co2_trend_layouts[] = {
+    {.text = {"CO2      -", ""}, .has_sparkline = true, .sparkline_metric = SENSOR_METRIC_CO2},
+};
+
+static const screen_layout_t voc_trend_layouts[] = {
+    {.text = {"VOC      -", ""}, .has_sparkline = true, .sparkline_metric = SENSOR_METRIC_VOC},
+};
+
+#ifdef CONFIG_DISPLAY_20X4
+static const screen_field_t dashboard_fields[] = {
+    {.row = 0, .column = 5,  .width = 3, .get_value = get_average_temp},
+    {.row = 0, .column = 15, .width = 3, .get_value = get_average_humidity},
+    {.row = 1, .column = 4,  .width = 5, .get_value = get_average_co2},
+    {.row = 2, .column = 4,  .width = 5, .get_value = get_average_voc},
+    {.row = 3, .column = 4,  .width = 3, .get_value = get_dew_point},
+    {.row = 3, .column = 13, .width = 3, .get_value = get_heat_index},
+};
+static const screen_layout_t dashboard_layouts[] = {
+    {.text = {"Temp    F  Hum    %", "CO2       ppm", "VOC       ppb", "Dew    F  HI    F"}, .fields = dashboard_fields, .field_count = 6},
+};
+#endif
+
+static const screen_layout_t powering_down_layouts[] = {
+    {.text = {"Powering down,", "Release button"}},
+};
+
+// If something goes wrong and the error screen needs to be set, display this so user can power cycle the device
+static const screen_layout_t error_layouts[] = {
+    {.text = {"ERROR", ""}},
+};
+
+static const screen_template_t screen_templates[SCREEN_PAGE_COUNT] = {
+    [STARTUP_SCREEN]              = {.layouts = startup_layouts},
+    [TEMPERATURE_HUMIDITY_SCREEN] = {.layouts = temp_humid_layouts},
+    [TEMPERATURE_TREND_SCREEN]    = {.layouts = temp_trend_layouts},
+    [HUMIDITY_TREND_SCREEN]       = {.layouts = humidity_trend_layouts},
+    [DERIVED_METRICS_SCREEN]      = {.layouts = derived_metrics_layouts, .select_layout = select_derived_metrics_layout},
+    [CO2_SCREEN]                  = {.layouts = co2_layouts, .select_layout = select_co2_layout},
+    [CO2_TREND_SCREEN]            = {.layouts = co2_trend_layouts},
+    [VOC_SCREEN]                  = {.layouts = voc_layouts},
+    [VOC_TREND_SCREEN]            = {.layouts = voc_trend_layouts},
+#ifdef CONFIG_DISPLAY_20X4
+    [DASHBOARD_SCREEN]            = {.layouts = dashboard_layouts},
+#endif
+    [SET_CO2_THRESH_SCREEN]       = {.layouts = co2_thresh_layouts},
+    [SET_VOC_THRESH_SCREEN]       = {.layouts = voc_thresh_layouts},
+    [POWERING_DOWN_SCREEN]        = {.layouts = powering_down_layouts},
+    [ERROR_SCREEN]                = {.layouts = error_layouts},
+};
+
+// The page whose fixed text is currently in the framebuffer, so a field update knows it can skip redrawing it
+static display_screen_pages_t rendered_page = SCREEN_PAGE_COUNT;
+static uint8_t rendered_layout = 0;
+
+/*********************************
+ * @brief Draws a metric's history as a row of bar characters, with the range the bars are scaled to above it.
+ *        The bar characters are only uploaded to the display the first time
+ ********************************/
+static void draw_sparkline(sensor_metric_t metric)
 {
-    clear_display_screen(); 
-    reset_text_buffers();
+    sparkline_t sparkline;
+    char range_text[SPARKLINE_RANGE_WIDTH + 1];
 
-    sprintf(display_text_buf_line1, "Powering down,");
-    sprintf(display_text_buf_line2, "Release button");
+    framebuffer_set_line(1, "");
+    memset(range_text, ' ', SPARKLINE_RANGE_WIDTH);
+    range_text[SPARKLINE_RANGE_WIDTH] = '\0';
+    framebuffer_write_text(0, SPARKLINE_LOW_COLUMN, range_text);
+    framebuffer_write_text(0, SPARKLINE_HIGH_COLUMN, range_text);
 
-    ESP_ERROR_CHECK(i2c_master_transmit(i2c_display_device_handle, (uint8_t *)display_text_buf_line1, strlen(display_text_buf_line1), pdMS_TO_TICKS(500)));
+    if(!build_sparkline(metric, &sparkline))
+    {
+        framebuffer_set_line(1, "No data yet");
+        return;
+    }
+    if(define_sparkline_glyphs() != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Error defining sparkline characters");
+        return;
+    }
+
+    format_fixed_width(range_text, sparkline.low, SPARKLINE_RANGE_WIDTH, 0);
+    framebuffer_write_text(0, SPARKLINE_LOW_COLUMN, range_text);
+    format_fixed_width(range_text, sparkline.high, SPARKLINE_RANGE_WIDTH, 0);
+    framebuffer_write_text(0, SPARKLINE_HIGH_COLUMN, range_text);
 
-    move_cursor_to_second_row();
-    ESP_ERROR_CHECK(i2c_master_transmit(i2c_display_device_handle, (uint8_t *)display_text_buf_line2, strlen(display_text_buf_line2), pdMS_TO_TICKS(500)));
+    for(uint8_t col = 0; col < SPARKLINE_COLUMNS; col++)
+    {
+        if(sparkline.level[col] > 0)
+        {
+            framebuffer_write_glyph(1, col, sparkline.level[col] - 1);
+        }
+    }
 }
 
-void set_co2_thresh_screen_init()
+/*********************************
+ * @brief Formats each field of a layout into its slot in the framebuffer, and the sparkline if it has one. A field with
+ *        nothing to show is left blank
+ ********************************/
+static void draw_layout_fields(const screen_layout_t *layout)
 {
-    esp_err_t err = ESP_FAIL;
-
-    clear_display_screen(); 
-    reset_text_buffers();
+    char field_text[DISPLAY_COLUMNS + 1];
 
-    sprintf(display_text_buf_line1, "CO2 Thresh:");
-    sprintf(display_text_buf_line2, "   %d ppm", sensor_data_buffer.co2_user_threshold);
-    err = i2c_master_transmit(i2c_display_device_handle, (uint8_t *)display_text_buf_line1, strlen(display_text_buf_line1), pdMS_TO_TICKS(500));
-
-    move_cursor_to_second_row();
+    for(uint8_t i = 0; i < layout->field_count; i++)
+    {
+        const screen_field_t *field = &layout->fields[i];
+        int32_t value = 0;
+        if(field->get_value(&value))
+        {
+            format_fixed_width(field_text, value, field->width, field->decimals);
+        }
+        else
+        {
+            memset(field_text, ' ', field->width);
+            field_text[field->width] = '\0';
+        }
+        framebuffer_write_text(field->row, field->column, field_text);
+    }
 
-    err = i2c_master_transmit(i2c_display_device_handle, (uint8_t *)display_text_buf_line2, strlen(display_text_buf_line2), pdMS_TO_TICKS(500));
-    if(err != ESP_OK)
+    if(layout->has_sparkline)
     {
-        ESP_LOGE(TAG, "Error sending CO2 thresh");
+        draw_sparkline(layout->sparkline_metric);
     }
 }
 
-void set_voc_thresh_screen_init()
+/*********************************
+ * @brief Draws a screen from the table into the framebuffer and sends whatever changed. The layout's fixed text is
+ *        drawn first, then each field is formatted into its slot
+ * @param page is the screen to draw, anything outside the table draws the error screen
+ ********************************/
+void render_screen_page(display_screen_pages_t page)
 {
-    esp_err_t err = ESP_FAIL;
+    if(page >= SCREEN_PAGE_COUNT || screen_templates[page].layouts == NULL)
+    {
+        page = ERROR_SCREEN;
+    }
 
-    clear_display_screen(); 
-    reset_text_buffers();
+    const screen_template_t *screen = &screen_templates[page];
+    uint8_t layout_index = screen->select_layout ? screen->select_layout() : 0;
+    const screen_layout_t *layout = &screen->layouts[layout_index];
 
-    sprintf(display_text_buf_line1, "VOC Thresh:");
-    sprintf(display_text_buf_line2, "   %d ppb", sensor_data_buffer.voc_user_threshold);
-    err = i2c_master_transmit(i2c_display_device_handle, (uint8_t *)display_text_buf_line1, strlen(display_text_buf_line1), pdMS_TO_TICKS(500));
+    framebuffer_clear();
+    for(uint8_t row = 0; row < DISPLAY_ROWS; row++)
+    {
+        if(layout->text[row] != NULL)  // Layouts written for two rows leave the rest of a larger display blank
+        {
+            framebuffer_write_text(row, 0, layout->text[row]);
+        }
+    }
+    draw_layout_fields(layout);
 
-    move_cursor_to_second_row();
+    rendered_page = page;
+    rendered_layout = layout_index;
 
-    err = i2c_master_transmit(i2c_display_device_handle, (uint8_t *)display_text_buf_line2, strlen(display_text_buf_line2), pdMS_TO_TICKS(500));
-    if(err != ESP_OK)
+    if(framebuffer_flush() != ESP_OK)
     {
-        ESP_LOGE(TAG, "Error sending VOC thresh to screen");
+        ESP_LOGE(TAG, "Error sending screen %d", page);
     }
 }
 
-/***********************************
- * @brief If something goes wrong and the error screen needs to be set, display this so user can power cycle the device
- */
-void error_screen_init()
+/*********************************
+ * @brief Redraws only the values of the page already on screen, leaving its fixed text alone. Used where one number
+ *        changes many times a second, like holding a button on a threshold screen. If the page or its layout is not
+ *        the one on screen, this falls back to a full render
+ * @param page is the screen whose values changed
+ ********************************/
+void render_screen_fields(display_screen_pages_t page)
 {
-    esp_err_t err = ESP_FAIL;
+    if(page >= SCREEN_PAGE_COUNT || page != rendered_page)
+    {
+        render_screen_page(page);
+        return;
+    }
 
-    clear_display_screen(); 
-    reset_text_buffers();
+    const screen_template_t *screen = &screen_templates[page];
+    uint8_t layout_index = screen->select_layout ? screen->select_layout() : 0;
+    if(layout_index != rendered_layout)
+    {
+        render_screen_page(page);
+        return;
+    }
+
+    draw_layout_fields(&screen->layouts[layout_index]);
 
-    sprintf(display_text_buf_line1, "ERROR");
-    err = i2c_master_transmit(i2c_display_device_handle, (uint8_t *)display_text_buf_line1, strlen(display_text_buf_line1), pdMS_TO_TICKS(100));
-}
\ No newline at end of file
+    if(framebuffer_flush() != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Error sending fields of screen %d", page);
+    }
+}
@@ -1,14 +1,43 @@
-#ifndef UI_SCREEN_INTIS_H
+#ifndef UI_SCREEN_INITS_H
 #define UI_SCREEN_INITS_H
 
-// Functions called to send strings to screen
-void startup_screen_init();
-void temp_humid_screen_init();
-void co2_screen_init();
-void voc_screen_init();
-void set_co2_thresh_screen_init();
-void set_voc_thresh_screen_init(); 
-void error_screen_init();
-void set_powering_down_screen();
-
-#endif // UI_SCREEN_INITS_H
\ No newline at end of file
+#include "stdint.h"
+#include "stdbool.h"
+#include "iaq_ui.h"
+#include "display_framebuffer.h"
+#include "general_sensors.h"
+
+/************************************
+ * A value drawn into a screen. The getter returns false when there is nothing to show, and the field is left blank
+ ***********************************/
+typedef struct {
+    uint8_t row;
+    uint8_t column;
+    uint8_t width;     // Characters reserved for the value, it is right aligned within them
+    uint8_t decimals;  // The value is scaled by 10^decimals, a decimal point is inserted this many digits from the right
+    bool (*get_value)(int32_t *value);
+} screen_field_t;
+
+/************************************
+ * Fixed text for each row plus the fields drawn on top of it
+ ***********************************/
+typedef struct {
+    const char *text[DISPLAY_ROWS];
+    const screen_field_t *fields;
+    uint8_t field_count;
+    bool has_sparkline;                // Row 0 gets the low and high of the window, row 1 the bars
+    sensor_metric_t sparkline_metric;
+} screen_layout_t;
+
+/************************************
+ * One entry per screen page. Screens whose fixed text depends on the data have several layouts and a selector
+ ***********************************/
+typedef struct {
+    const screen_layout_t *layouts;
+    uint8_t (*select_layout)();  // NULL if the screen only has one layout
+} screen_template_t;
+
+void render_screen_page(display_screen_pages_t page);
+void render_screen_fields(display_screen_pages_t page);
+
+#endif // UI_SCREEN_INITS_H
@@ -5,9 +5,12 @@
 #include "Userbuttons.h"
 #include "iaq_ui.h"
 #include "ui_screen_inits.h"
+#include "display_render.h"
 #include "general_sensors.h"
 #include "power_button.h"
 #include "driver/gpio.h"
+#include "ui_latency.h"
+#include "button_gestures.h"
 
 // User cannot set threshold greater than this, as this is already dangerous
 #define MAX_CO2_THRESHOLD 1000
@@ -16,8 +19,13 @@
 #define MAX_VOC_THRESH    400
 #define MIN_VOC_THRESH    200
 
-// Variable to only change brightness of backlight on first user interaction
-bool backlight_updated = false;
+// Holding a threshold button repeats every GESTURE_REPEAT_PERIOD_MS. The step grows the longer it is held so a long
+// adjustment takes about a second: single steps for the first half second, then steps of 10, then steps of 50
+#define AUTO_REPEAT_FINE_TICKS  10
+#define AUTO_REPEAT_MID_TICKS   20
+#define AUTO_REPEAT_FINE_STEP   1
+#define AUTO_REPEAT_MID_STEP    10
+#define AUTO_REPEAT_COARSE_STEP 50
 
 /***************************
  * @brief If user button 2 is pressed while the screen is either the CO2 or VOC level,
@@ -36,12 +44,24 @@ void get_setpoint_screen()
         case VOC_SCREEN:
             next_page = SET_VOC_THRESH_SCREEN;
             break;
+#ifdef CONFIG_DISPLAY_20X4
+        case DASHBOARD_SCREEN:     // The dashboard covers both gases, so step through both thresholds and back
+            next_page = SET_CO2_THRESH_SCREEN;
+            break;
+        case SET_CO2_THRESH_SCREEN:
+            next_page = SET_VOC_THRESH_SCREEN;
+            break;
+        case SET_VOC_THRESH_SCREEN:
+            next_page = DASHBOARD_SCREEN;
+            break;
+#else
         case SET_CO2_THRESH_SCREEN: // Done setting threshold, return to CO2 screen
             next_page = CO2_SCREEN;
             break;
         case SET_VOC_THRESH_SCREEN: 
             next_page = VOC_SCREEN;
             break;
+#endif
         default:  // do nothing
             next_page = current_page;
             break;
@@ -51,71 +71,143 @@ void get_setpoint_screen()
     set_ui_screen_page(current_page);
 }
 
-void repeated_increment_while_held(uint16_t *sensor_threshold)
+/********************************
+ * @brief Gets the allowed range and default of the threshold that is adjusted on a setpoint screen
+ * @returns false if the page is not a setpoint screen
+ *******************************/
+static bool get_threshold_for_page(display_screen_pages_t page, uint16_t **threshold, uint16_t *min, uint16_t *max, uint16_t *default_value)
 {
-    vTaskDelay(pdMS_TO_TICKS(500));  // Give 500ms to see if the button was held or not
-    while(gpio_get_level(USR_BTN_THREE_PIN) == 0) // decrease every 50ms while held
+    switch(page)
     {
-        (*sensor_threshold)++;
-        set_ui_screen_page(current_page);
-        vTaskDelay(pdMS_TO_TICKS(50));
+        case SET_CO2_THRESH_SCREEN:
+            *threshold = &sensor_data_buffer.co2_user_threshold;
+            *min = MIN_CO2_THRESHOLD;
+            *max = MAX_CO2_THRESHOLD;
+            *default_value = DEFAULT_CO2_USER_THRESHOLD;
+            return true;
+        case SET_VOC_THRESH_SCREEN:
+            *threshold = &sensor_data_buffer.voc_user_threshold;
+            *min = MIN_VOC_THRESH;
+            *max = MAX_VOC_THRESH;
+            *default_value = DEFAULT_VOC_USER_THRESHOLD;
+            return true;
+        default:
+            return false;
     }
 }
 
 /********************************
- * @brief when the button is pressed while on one of the setpoint screens, increment the
- *        setpoint. If max value is reached or the current screen is not a setpoint screen, do nothing
+ * @brief Moves a threshold by a number of steps, keeping it within its allowed range
+ * @returns true if the threshold changed
  *******************************/
-void increment_gas_setpoint()
+static bool step_threshold(uint16_t *threshold, int32_t step, uint16_t min, uint16_t max)
 {
-    switch(current_page)
+    int32_t new_value = (int32_t)*threshold + step;
+
+    if(new_value < min)
     {
-        case SET_CO2_THRESH_SCREEN:
-            sensor_data_buffer.co2_user_threshold++;
-            set_ui_screen_page(current_page);
-            repeated_increment_while_held(&sensor_data_buffer.co2_user_threshold);
-            break;
-        case SET_VOC_THRESH_SCREEN:
-            sensor_data_buffer.voc_user_threshold++;
-            set_ui_screen_page(current_page);
-            repeated_increment_while_held(&sensor_data_buffer.voc_user_threshold);
-            break;
-        default:
-            break;
+        new_value = min;
+    }
+    else if(new_value > max)
+    {
+        new_value = max;
     }
+
+    if(new_value == *threshold)
+    {
+        return false;
+    }
+    *threshold = (uint16_t)new_value;
+    return true;
 }
 
-void repeated_decrement_while_held(uint16_t *sensor_threshold)
+/********************************
+ * @brief Gets how far one auto-repeat tick moves the threshold, based on how long the button has been held
+ *******************************/
+static int32_t get_auto_repeat_step(uint32_t repeat_ticks)
 {
-    vTaskDelay(pdMS_TO_TICKS(500));  // Give 500ms to see if the button was held or not
-    while(gpio_get_level(USR_BTN_FOUR_PIN) == 0) // decrease every 50ms while held
+    if(repeat_ticks < AUTO_REPEAT_FINE_TICKS)
+    {
+        return AUTO_REPEAT_FINE_STEP;
+    }
+    if(repeat_ticks < AUTO_REPEAT_MID_TICKS)
     {
-        (*sensor_threshold)--;
-        set_ui_screen_page(current_page);
-        vTaskDelay(pdMS_TO_TICKS(50));
+        return AUTO_REPEAT_MID_STEP;
     }
+    return AUTO_REPEAT_COARSE_STEP;
 }
 
 /********************************
- * @brief when the button is pressed while on one of the setpoint screens, decrement the
+ * @brief Moves the setpoint shown on the current setpoint screen and redraws only the number.
+ *        If the current screen is not a setpoint screen, do nothing
+ * @param step is how far to move it, negative to decrement
+ *******************************/
+static void adjust_gas_setpoint(int32_t step)
+{
+    uint16_t *threshold = NULL;
+    uint16_t min = 0;
+    uint16_t max = 0;
+    uint16_t default_value = 0;
+
+    if(!get_threshold_for_page(current_page, &threshold, &min, &max, &default_value))
+    {
+        return;
+    }
+
+    if(step_threshold(threshold, step, min, max))
+    {
+        request_screen_field_render(current_page);
+        notify_display_task(DISPLAY_NOTIFY_ALARM_INPUTS);
+    }
+}
+
+/********************************
+ * @brief when the button is pressed while on one of the setpoint screens, increment the
  *        setpoint. If max value is reached or the current screen is not a setpoint screen, do nothing
  *******************************/
+void increment_gas_setpoint()
+{
+    adjust_gas_setpoint(1);
+}
+
+/********************************
+ * @brief when the button is pressed while on one of the setpoint screens, decrement the
+ *        setpoint. If min value is reached or the current screen is not a setpoint screen, do nothing
+ *******************************/
 void decrement_gas_setpoint()
 {
-    switch(current_page)
+    adjust_gas_setpoint(-1);
+}
+
+/********************************
+ * @brief Keeps moving the setpoint while button 3 or 4 is held, with a step that grows with the number of repeats
+ * @param direction is 1 to increment and -1 to decrement
+ *******************************/
+static void repeat_gas_setpoint(int8_t direction, uint32_t repeat_count)
+{
+    adjust_gas_setpoint(direction * get_auto_repeat_step(repeat_count));
+}
+
+/********************************
+ * @brief Buttons 3 and 4 pressed together put the setpoint on the current setpoint screen back to its default
+ *******************************/
+static void reset_gas_setpoint()
+{
+    uint16_t *threshold = NULL;
+    uint16_t min = 0;
+    uint16_t max = 0;
+    uint16_t default_value = 0;
+
+    if(!get_threshold_for_page(current_page, &threshold, &min, &max, &default_value))
     {
-        case SET_CO2_THRESH_SCREEN:
-            sensor_data_buffer.co2_user_threshold--;
-            set_ui_screen_page(current_page);
-            repeated_decrement_while_held(&sensor_data_buffer.co2_user_threshold);
-            break;
-            case SET_VOC_THRESH_SCREEN:
-            sensor_data_buffer.voc_user_threshold--;
-            set_ui_screen_page(current_page);
-            repeated_decrement_while_held(&sensor_data_buffer.voc_user_threshold);
-            break;
-        default:
-            break;
+        return;
+    }
+
+    if(*threshold != default_value)
+    {
+        *threshold = default_value;
+        request_screen_field_render(current_page);
+        notify_display_task(DISPLAY_NOTIFY_ALARM_INPUTS);
     }
 }
 
@@ -146,48 +238,77 @@ void handle_button_press(int btn_id)
             case USR_BTN_FOUR_PIN:          // If on setpoint screen, decrement user threshold
                 decrement_gas_setpoint();
                 break;
-            case PWR_BTN_PIN:              // Acknowledge buzzer, put to sleep, or power off
-                handle_pwr_btn_press();
-                break;
             default:
                 break;
         }
 }
 
-// Needed on initial startup to prevent multiple brightness sets
-void set_backlight_updated()
+/**********************************
+ * @brief Acts on a gesture from the recognizer. Presses of buttons 1 to 4 act right away, holding 3 or 4 repeats
+ *        the setpoint step, and 3 and 4 together reset the setpoint. Everything on the power button is handled
+ *        in power_button.c
+ **********************************/
+void handle_button_gesture(const button_gesture_t *gesture)
 {
-    backlight_updated = true;
+    if(gesture->button_id == PWR_BTN_PIN)
+    {
+        handle_pwr_btn_gesture(gesture);
+        return;
+    }
+
+    switch(gesture->type)
+    {
+        case BUTTON_GESTURE_PRESS:
+            handle_button_press(gesture->button_id);
+            break;
+        case BUTTON_GESTURE_REPEAT:
+            if(gesture->button_id == USR_BTN_THREE_PIN)
+            {
+                repeat_gas_setpoint(1, gesture->repeat_count);
+            }
+            else if(gesture->button_id == USR_BTN_FOUR_PIN)
+            {
+                repeat_gas_setpoint(-1, gesture->repeat_count);
+            }
+            break;
+        case BUTTON_GESTURE_CHORD:
+            if((gesture->button_id == USR_BTN_THREE_PIN && gesture->chord_button_id == USR_BTN_FOUR_PIN) ||
+               (gesture->button_id == USR_BTN_FOUR_PIN && gesture->chord_button_id == USR_BTN_THREE_PIN))
+            {
+                reset_gas_setpoint();
+            }
+            break;
+        default:
+            break;
+    }
 }
 
 void user_button_task(void *parameter)
 {
     while(1)
     {
-        // Check for button presses, task blocked if nothing in queue
-        int button_pressed_id = 0;
-        if(xQueueReceive(user_button_queue, &button_pressed_id, portMAX_DELAY))
+        // Check for button gestures, task blocked if nothing in queue
+        button_gesture_t gesture;
+        if(xQueueReceive(user_button_queue, &gesture, portMAX_DELAY))
         {
-            if(user_button_debounce(button_pressed_id))  // Debounce button
+            // Only gestures that come straight from an edge are timed, holds and repeats come from a timer
+            bool timed = is_edge_gesture(&gesture);
+            if(timed)
             {
-                // will want to check here if the button is held or not
-                ESP_LOGI("BTN", "Button press sensed at GPIO %d", button_pressed_id);
-                handle_button_press(button_pressed_id);
+                ui_latency_begin_input(gesture.isr_time_us, gesture.debounced_time_us);
+            }
 
-                // The first time after the device has been woken up by a user, turn the backlights on, and set the variable so that
-                // it does not send the commands to turn backlights on every time through this task
-                if(!backlight_updated)
-                {
-                    power_display_on();
-                    backlight_updated = true;
-                }
+            ESP_LOGI("BTN", "Button gesture %d sensed at GPIO %d", gesture.type, gesture.button_id);
+            handle_button_gesture(&gesture);
 
-                // if the device currently says that display is off upon a press, reset it
-                if(is_display_off_in_consistent_sleep())
-                {
-                    reset_display_off_in_sleep();
-                }
+            // Make sure the display is on after user interaction. The display state model only sends anything the
+            // first time after the device has been woken up, so this is cheap on every gesture
+            power_display_on();
+
+            if(timed)
+            {
+                ui_latency_end_input();
             }
         }
     }
-}
\ No newline at end of file
+}
@@ -2,10 +2,10 @@
 #define USER_CONTROL_H
 
 #include "stdint.h"
+#include "button_gestures.h"
 
 void handle_button_press(int btn_id);
+void handle_button_gesture(const button_gesture_t *gesture);
 void user_button_task(void *parameter);
 
-void set_backlight_updated();
-
 #endif // USER_CONTROL_H
\ No newline at end of file
@@ -4,195 +4,279 @@
 #include "FreeRTOS/FreeRTOS.h"
 #include "FreeRTOS/queue.h"
 #include "Userbuttons.h"
+#include "button_gestures.h"
+#include "wake_lock.h"
+#include "power_mode.h"
 #include "esp_log.h"
 
 #define GPIO_INPUT_PIN_SEL  ((1ULL << USR_BTN_ONE_PIN) | (1ULL << USR_BTN_TWO_PIN) | (1ULL << USR_BTN_THREE_PIN) | (1ULL << USR_BTN_FOUR_PIN) | (1ULL << PWR_BTN_PIN))
-#define DEBOUNCE_DELAY (pdMS_TO_TICKS(20))   //10 ms delay
+// Integrator debounce: each tick moves a button's count one step toward its current level, and the press or release
+// only counts once the count reaches the end. Four 5ms ticks in a row is the 20ms settle time
+#define DEBOUNCE_TICK_US       5000
+#define DEBOUNCE_INTEGRATOR_MAX  4
 #define AVOID_SLEEP_TIME (120000000)  // 2 minutes in us
-#define TEN_SECOND_HOLD (10000000)   // 10 seconds in us 
-uint32_t last_button_press_time = AVOID_SLEEP_TIME;  // Make sure we do not avoid sleep if no user interaction since wake
 uint8_t last_button_pressed_id = 0;
 QueueHandle_t user_button_queue = NULL;
 
 const int USER_BUTTONS[] = {USR_BTN_ONE_PIN, USR_BTN_TWO_PIN, USR_BTN_THREE_PIN, USR_BTN_FOUR_PIN, PWR_BTN_PIN};
-const size_t NUM_BUTTONS = sizeof(USER_BUTTONS) / sizeof(USER_BUTTONS[0]);
+#define BUTTON_COUNT  (sizeof(USER_BUTTONS) / sizeof(USER_BUTTONS[0]))
 
-// This variable ensures that once the device is consistently in sleep mode with no user interaction, to only turn the backlights off once
-RTC_DATA_ATTR bool display_turned_off_in_sleep = false;
-bool wakeup_reason_checked = false;
+/************************************
+ * Debounce state for one button. Shared between the GPIO ISR and the debounce timer, so it is only touched
+ * inside button_lock
+ ***********************************/
+typedef struct {
+    uint8_t integrator;     // 0 is settled released, DEBOUNCE_INTEGRATOR_MAX is settled pressed
+    bool    pressed;        // Debounced state
+    bool    change_pending; // An edge was seen and the button has not settled since
+    int64_t edge_time_us;   // First edge of the change being debounced
+} button_debounce_t;
 
-/******************************************
- * @brief Checks if the button that is pressed was held for 10 seconds. Only needed for power button
- * @returns true if held for 10 seconds, false if not
- *****************************************/
-bool was_button_held_for_ten_seconds(int btn_id)
-{
-    uint32_t press_time = 0;
-    uint32_t release_time = 0;
-    uint32_t press_duration = 0;
+static button_debounce_t button_debounce[BUTTON_COUNT];
+static esp_timer_handle_t debounce_timer = NULL;
+static bool debounce_timer_running = false;
+static portMUX_TYPE button_lock = portMUX_INITIALIZER_UNLOCKED;
 
-    press_time = esp_timer_get_time();
-    while((gpio_get_level(btn_id) == 0) && (esp_timer_get_time() - press_time) <= TEN_SECOND_HOLD)
-    {}  // empty while loop, This will wait until either the button was held for 10 seconds, or the button was released before then
+// Holds the user interaction wake lock until AVOID_SLEEP_TIME after the last press. Only touched from the esp_timer
+// task, or from button_init before the buttons are live
+static esp_timer_handle_t user_interaction_timer = NULL;
+static bool user_interaction_locked = false;
 
-    release_time = esp_timer_get_time();
-    press_duration = release_time - press_time;
-    if(press_duration >= TEN_SECOND_HOLD)
-    {
-        return true;
-    }
-    else // not held for 10 seconds
-    {
-        return false;
-    }
-}
+// On a timer wake only the power button is watched, until a press brings up the rest of the buttons
+static bool isr_service_installed = false;
+static TaskHandle_t power_button_watch_task = NULL;
+static volatile bool power_button_watch_fired = false;
 
-/**********************************************
- * @brief Check if button was pressed and held for three seconds, used for power button to force enter sleep mode
- ***********************************************/
-bool was_button_held_for_three_seconds()
+/********************************
+ * @brief Keeps the device awake for AVOID_SLEEP_TIME after a press, starting the time over on every press. Light
+ *        sleep is held off for the same time, since the button edges are not seen in it
+ *******************************/
+static void note_user_interaction()
 {
-    return false;
+    if(!user_interaction_locked)
+    {
+        wake_lock_acquire(WAKE_LOCK_USER_INTERACTION);
+        power_lock_acquire(POWER_LOCK_USER_INPUT);
+        user_interaction_locked = true;
+    }
+    esp_timer_stop(user_interaction_timer);
+    esp_timer_start_once(user_interaction_timer, AVOID_SLEEP_TIME);
 }
 
-// This function is called upon user interaction so that once it goes back to sleep, this variable will be reset
-void reset_display_off_in_sleep()
+static void user_interaction_timer_callback(void *arg)
 {
-    display_turned_off_in_sleep = false;
+    if(user_interaction_locked)
+    {
+        user_interaction_locked = false;
+        power_lock_release(POWER_LOCK_USER_INPUT);
+        wake_lock_release(WAKE_LOCK_USER_INTERACTION);
+    }
 }
 
-// This function is used when the display is being powered down so that it only needs to be powered down once, not repeatedly
-void set_display_off_in_sleep()
+/*******************************************
+ * @brief Whether the user has interacted with the device in the last two minutes, counting the power on or power button
+ *        press that woke it. This reads the user interaction wake lock, so it always agrees with what keeps the
+ *        device awake
+ *******************************************/
+bool check_recent_user_interaction()
 {
-    display_turned_off_in_sleep = true;
+    return is_wake_lock_held(WAKE_LOCK_USER_INTERACTION);
 }
 
-// This funciton is used to check whether or not the display has already been turned off
-bool is_display_off_in_consistent_sleep()
+/********************************
+ * @brief Runs every 5ms while any button is changing. Each button's integrator moves toward the pin level, and a press
+ *        or release is handed to the gesture recognizer when it settles. The timer stops itself once every button is settled, so it only
+ *        runs right after an edge
+ *******************************/
+static void debounce_timer_callback(void *arg)
 {
-    return display_turned_off_in_sleep;
-}
+    button_event_t events[BUTTON_COUNT];
+    uint8_t event_count = 0;
+    int64_t now = esp_timer_get_time();
 
-void get_wakeup_reason_first_time()
-{
-    esp_sleep_wakeup_cause_t wakeup_cause = esp_sleep_get_wakeup_cause();
-    if(wakeup_cause == ESP_SLEEP_WAKEUP_EXT0)
+    taskENTER_CRITICAL(&button_lock);
+    bool all_settled = true;
+    for(uint8_t i = 0; i < BUTTON_COUNT; i++)
     {
-        last_button_press_time = esp_timer_get_time();
-        reset_display_off_in_sleep();
-    }
-    else if(wakeup_cause == ESP_SLEEP_WAKEUP_UNDEFINED)
-    {
-        last_button_press_time = 0;
-    }
-}
+        button_debounce_t *button = &button_debounce[i];
+        bool level_pressed = (gpio_get_level(USER_BUTTONS[i]) == 0);  // Buttons pull the pin low
 
+        if(level_pressed && button->integrator < DEBOUNCE_INTEGRATOR_MAX)
+        {
+            button->integrator++;
+        }
+        else if(!level_pressed && button->integrator > 0)
+        {
+            button->integrator--;
+        }
 
-/*******************************************
- * @brief This function will be called by the deep sleep task to check if the user has recently interacted with the device. This will prevent
- *        the device from entering deep sleep mode if there has been recent interaction
- *******************************************/
-bool check_recent_user_interaction()
-{
-    // If the power button was pressed to wake the device from deep sleep, make sure it avoids deep sleep
-    // only check this the first time the function is called to ensure deep sleep is not constantly avoided
-    if(!wakeup_reason_checked)
-    {
-        get_wakeup_reason_first_time();
-        wakeup_reason_checked = true;
+        bool settled_change = (button->integrator == DEBOUNCE_INTEGRATOR_MAX && !button->pressed) ||
+                              (button->integrator == 0 && button->pressed);
+        if(settled_change)
+        {
+            button->pressed = !button->pressed;
+            events[event_count++] = (button_event_t){
+                .button_id = USER_BUTTONS[i],
+                .type = button->pressed ? BUTTON_EVENT_PRESS : BUTTON_EVENT_RELEASE,
+                .isr_time_us = button->edge_time_us,
+                .debounced_time_us = now,
+            };
+        }
+
+        if(button->integrator != (button->pressed ? DEBOUNCE_INTEGRATOR_MAX : 0))
+        {
+            all_settled = false;
+        }
+        else
+        {
+            button->change_pending = false;
+        }
     }
-    // Get the current run time. If it is more than 2 minutes pst the last time that a button as pressed, return false.
-    // If not, rturn true, preventing deep sleep will be avoided
-    uint32_t current_time = esp_timer_get_time();
-    if((current_time - last_button_press_time) >= AVOID_SLEEP_TIME)
+
+    if(all_settled)
     {
-       return false;
+        esp_timer_stop(debounce_timer);
+        debounce_timer_running = false;
     }
-    else
+    taskEXIT_CRITICAL(&button_lock);
+
+    for(uint8_t i = 0; i < event_count; i++)
     {
-        return true; // Will prevent deep sleep
+        if(events[i].type == BUTTON_EVENT_PRESS)
+        {
+            note_user_interaction();
+        }
+        button_gestures_handle_event(&events[i]);
     }
 }
 
-/*********************
- * @brief This function debounces button presses to ensure that when a button is pressed, it is only read once, 
- *        rather than a few times due to the signal ripple when a button is pressed
- ********************/
-bool user_button_debounce(int btn_id)
+/********************************
+ * @brief Called on every edge of any button, including bounces. It notes when a change started and makes sure the
+ *        debounce timer is running, the timer does the actual debouncing
+ */
+static void IRAM_ATTR user_button_isr_handler(void* arg)
 {
-    // Disable the interrupt so only the first press is detected as a press
-    gpio_intr_disable(btn_id);
-
-    bool button_status[8] = {0};
+    uint8_t index = (uint8_t)(uintptr_t)arg;
 
-    // Check the button status every 10ms for 80ms total
-    for(uint8_t i = 0; i < 8; i++)
+    taskENTER_CRITICAL_ISR(&button_lock);
+    button_debounce_t *button = &button_debounce[index];
+    if(!button->change_pending)  // First edge since the button settled, later ones are bounces
     {
-        button_status[i] = gpio_get_level(btn_id);
-        vTaskDelay(DEBOUNCE_DELAY); // delay 10ms then re-read
+        button->edge_time_us = esp_timer_get_time();
+        button->change_pending = true;
     }
-
-    // If there are fours consecutive lows in this check, then the button was pressed
-    for(uint8_t j = 0; j < 4; j++)
+    if(!debounce_timer_running)
     {
-        if (!button_status[j] && !button_status[j+1] && !button_status[j+2] && !button_status[j+3])
-        {
-            // Found 4 consecutive lows, take down last button press time, re-enable interrupt, and return true for button press
-            last_button_press_time = esp_timer_get_time();
-            gpio_intr_enable(btn_id);
-            return true;
-        }
+        esp_timer_start_periodic(debounce_timer, DEBOUNCE_TICK_US);
+        debounce_timer_running = true;
     }
-    // Return false if the end of the function is reached, meaning there were not four consecutive lows, and re-enable interrupt
-    gpio_intr_enable(btn_id);
-    return false;
+    taskEXIT_CRITICAL_ISR(&button_lock);
 }
 
 /********************************
- * @brief This function is called when a button press is detected. It will debounce the button press, and then add
- *        the ID of the pressed button to the button queue
+ * @brief Power button pressed while only it is watched. The level interrupt is turned off so it fires once, and the
+ *        watching task is told to bring up the buttons
  */
-static void IRAM_ATTR user_button_isr_handler(void* id)
+static void IRAM_ATTR power_button_watch_isr_handler(void* arg)
 {
-    int button_press_id = (int)id;
-    // Add the ID of the button that was pressed to the queue
-    xQueueSendFromISR(user_button_queue, &button_press_id, NULL);
+    BaseType_t higher_priority_task_woken = pdFALSE;
+    gpio_intr_disable(PWR_BTN_PIN);
+    power_button_watch_fired = true;
+    vTaskNotifyGiveFromISR(power_button_watch_task, &higher_priority_task_woken);
+    portYIELD_FROM_ISR(higher_priority_task_woken);
 }
 
-
-gpio_config_t lrg_bzr_pin_config = {
-    .mode = GPIO_MODE_OUTPUT,
-    .intr_type = GPIO_MODE_OUTPUT,
-    .pull_down_en = GPIO_PULLDOWN_DISABLE,
-    .pull_up_en   = GPIO_PULLUP_DISABLE,
-    .pin_bit_mask = (1ULL << LARGE_BUZZER_PIN)
-};
+static void install_button_isr_service()
+{
+    if(!isr_service_installed)
+    {
+        ESP_ERROR_CHECK(gpio_install_isr_service(ESP_INTR_FLAG_LEVEL1));
+        isr_service_installed = true;
+    }
+}
 
     // Basic configuration for interrupt, pin will be set before the ISR is initialized
     gpio_config_t btn_config = {
         .mode = GPIO_MODE_INPUT,
-        .intr_type = GPIO_INTR_NEGEDGE,
+        .intr_type = GPIO_INTR_ANYEDGE,   // Both edges, so releases are debounced too
         .pin_bit_mask = GPIO_INPUT_PIN_SEL,
         .pull_down_en = GPIO_PULLDOWN_DISABLE,
         .pull_up_en = GPIO_PULLUP_ENABLE
 };
 
+/******************
+ * @brief Watches only the power button, for wakes where the rest of the buttons are not set up. The interrupt is on
+ *        the low level rather than an edge so a press also wakes the device from light sleep. The task is notified on
+ *        the first press, and should then call button_init, which takes the pin over
+ *****************/
+void power_button_watch_init(TaskHandle_t task_to_notify)
+{
+    install_button_isr_service();
+    power_button_watch_task = task_to_notify;
+
+    gpio_config_t watch_config = {
+        .mode = GPIO_MODE_INPUT,
+        .intr_type = GPIO_INTR_LOW_LEVEL,
+        .pin_bit_mask = (1ULL << PWR_BTN_PIN),
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .pull_up_en = GPIO_PULLUP_ENABLE
+    };
+    ESP_ERROR_CHECK(gpio_config(&watch_config));
+    ESP_ERROR_CHECK(gpio_isr_handler_add(PWR_BTN_PIN, power_button_watch_isr_handler, NULL));
+    ESP_ERROR_CHECK(gpio_wakeup_enable(PWR_BTN_PIN, GPIO_INTR_LOW_LEVEL));
+    ESP_ERROR_CHECK(esp_sleep_enable_gpio_wakeup());
+}
+
 /******************
  * @brief Configures the GPIO interrupts for all five buttons
  *****************/
 void button_init()
 {
-	gpio_config(&lrg_bzr_pin_config);
+    install_button_isr_service();
+    if(power_button_watch_task != NULL)
+    {
+        gpio_isr_handler_remove(PWR_BTN_PIN);
+        gpio_wakeup_disable(PWR_BTN_PIN);
+        power_button_watch_task = NULL;
+    }
 
-    ESP_ERROR_CHECK(gpio_install_isr_service(ESP_INTR_FLAG_LEVEL1));
+    // Create the queue that will be read from for button gestures, and the timers that debounce and recognize them
+    user_button_queue = xQueueCreate(10, sizeof(button_gesture_t));
+    const esp_timer_create_args_t debounce_timer_args = {
+        .callback = debounce_timer_callback,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "button_debounce",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&debounce_timer_args, &debounce_timer));
+    button_gestures_init();
 
-    // Initialize all five buttons as interrupts
-    ESP_ERROR_CHECK(gpio_config(&btn_config));
-    for(uint8_t i = 0; i < NUM_BUTTONS ; i++)
+    // Powering on or waking up from the power button counts as a press, the user wants to see the screen. So does the
+    // press that brought the buttons up on a timer wake
+    const esp_timer_create_args_t interaction_timer_args = {
+        .callback = user_interaction_timer_callback,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "user_interaction",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&interaction_timer_args, &user_interaction_timer));
+    esp_sleep_wakeup_cause_t wakeup_cause = esp_sleep_get_wakeup_cause();
+    if(wakeup_cause == ESP_SLEEP_WAKEUP_UNDEFINED || wakeup_cause == ESP_SLEEP_WAKEUP_EXT0 || power_button_watch_fired)
     {
-        ESP_ERROR_CHECK(gpio_isr_handler_add(USER_BUTTONS[i], user_button_isr_handler, (void*)USER_BUTTONS[i]));
-    }  
+        note_user_interaction();
+    }
 
-    // Create the queue that will be read from for button presses
-    user_button_queue = xQueueCreate(6, sizeof(USR_BTN_ONE_PIN));
+    // A button already held at boot, like the power button that woke the device, starts out settled as pressed
+    // so its release is not mistaken for a new press
+    for(uint8_t i = 0; i < BUTTON_COUNT; i++)
+    {
+        bool held = (gpio_get_level(USER_BUTTONS[i]) == 0);
+        button_debounce[i].pressed = held;
+        button_debounce[i].integrator = held ? DEBOUNCE_INTEGRATOR_MAX : 0;
+    }
+
+    // Initialize all five buttons as interrupts, the handler gets the button's index into USER_BUTTONS
+    ESP_ERROR_CHECK(gpio_config(&btn_config));
+    for(uint8_t i = 0; i < BUTTON_COUNT ; i++)
+    {
+        ESP_ERROR_CHECK(gpio_isr_handler_add(USER_BUTTONS[i], user_button_isr_handler, (void*)(uintptr_t)i));
+    }
 }
\ No newline at end of file
@@ -3,7 +3,9 @@
 
 #include "FreeRTOS/FreeRTOS.h"
 #include "FreeRTOS/queue.h"
+#include "FreeRTOS/task.h"
 #include "stdbool.h"
+#include "stdint.h"
 
 #define PWR_BTN_PIN       14
 #define USR_BTN_ONE_PIN   9
@@ -12,16 +14,27 @@
 #define USR_BTN_FOUR_PIN  13
 #define LARGE_BUZZER_PIN  3
 
+typedef enum {
+    BUTTON_EVENT_PRESS = 0,
+    BUTTON_EVENT_RELEASE
+} button_event_type_t;
+
+/************************************
+ * What the debouncer hands to the gesture recognizer once a press or release settles. The edge time lets the press be
+ * timed all the way to the screen
+ ***********************************/
+typedef struct {
+    int button_id;
+    button_event_type_t type;
+    int64_t isr_time_us;        // First edge of the change
+    int64_t debounced_time_us;  // When the change settled
+} button_event_t;
+
 extern QueueHandle_t user_button_queue;
 void button_init();
-bool was_button_held_for_ten_seconds(int btn_id);
+void power_button_watch_init(TaskHandle_t task_to_notify);
 bool check_recent_user_interaction();
-bool user_button_debounce(int btn_id);
 
-// Used for only turning the display off once in consistent deep sleep
-bool is_display_off_in_consistent_sleep();
-void set_display_off_in_sleep();
-void reset_display_off_in_sleep();
 void set_recent_user_interaction_for_sleep();
 
 #endif // USERBUTTONS_H
\ No newline at end of file
@@ -0,0 +1,253 @@
+#include "button_gestures.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "FreeRTOS/FreeRTOS.h"
+#include "FreeRTOS/queue.h"
+
+static const char *TAG = "GESTURES";
+
+/************************************
+ * Which gestures each button reports. Buttons with no holds or repeats never start a timer, so a held button costs
+ * nothing until it is released
+ ***********************************/
+typedef struct {
+    int  button_id;
+    bool holds;         // Report the 3s and 10s holds
+    bool repeats;       // Report repeats while held
+    bool double_click;  // Report double-clicks
+} button_gesture_config_t;
+
+static const button_gesture_config_t gesture_config[] = {
+    { .button_id = USR_BTN_ONE_PIN },
+    { .button_id = USR_BTN_TWO_PIN },
+    { .button_id = USR_BTN_THREE_PIN, .repeats = true },
+    { .button_id = USR_BTN_FOUR_PIN,  .repeats = true },
+    { .button_id = PWR_BTN_PIN,       .holds = true, .double_click = true },
+};
+#define GESTURE_BUTTON_COUNT  (sizeof(gesture_config) / sizeof(gesture_config[0]))
+
+/************************************
+ * Recognizer state for one button. The debounce timer and the gesture timers both run from the esp_timer task, one
+ * callback at a time, so this needs no lock
+ ***********************************/
+typedef struct {
+    esp_timer_handle_t timer;       // One-shot, armed for the next hold or repeat while the button is held
+    bool     pressed;
+    bool     consumed;              // Used up by a chord or double-click, nothing more is reported until release
+    uint8_t  holds_reported;        // 0 none, 1 after the 3s hold, 2 after the 10s hold
+    uint32_t repeat_count;
+    int64_t  last_short_release_us; // Release time of the last short press, 0 if the next press cannot be a double-click
+} button_gesture_state_t;
+
+static button_gesture_state_t gesture_state[GESTURE_BUTTON_COUNT];
+
+/**********************************
+ * @brief Gets the index of a button in gesture_config
+ * @returns -1 if the button is not one the recognizer knows
+ *********************************/
+static int get_gesture_index(int button_id)
+{
+    for(int i = 0; i < GESTURE_BUTTON_COUNT; i++)
+    {
+        if(gesture_config[i].button_id == button_id)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void send_gesture(button_gesture_type_t type, int index, int64_t isr_time_us, int64_t debounced_time_us)
+{
+    button_gesture_t gesture = {
+        .type = type,
+        .button_id = gesture_config[index].button_id,
+        .chord_button_id = -1,
+        .repeat_count = gesture_state[index].repeat_count,
+        .isr_time_us = isr_time_us,
+        .debounced_time_us = debounced_time_us,
+    };
+    if(xQueueSend(user_button_queue, &gesture, 0) != pdTRUE)
+    {
+        ESP_LOGE(TAG, "Button queue full, dropped gesture %d for GPIO %d", type, gesture.button_id);
+    }
+}
+
+/**********************************
+ * @brief Fires once per hold or repeat step while a button is held. It reports the step and arms itself for the next
+ *        one, the 10s hold is the last step so the timer stays idle after it
+ *********************************/
+static void gesture_timer_callback(void *arg)
+{
+    int index = (int)(uintptr_t)arg;
+    button_gesture_state_t *state = &gesture_state[index];
+    int64_t now = esp_timer_get_time();
+
+    if(!state->pressed || state->consumed)  // Released or used up between the timer firing and this callback running
+    {
+        return;
+    }
+
+    if(gesture_config[index].repeats)
+    {
+        send_gesture(BUTTON_GESTURE_REPEAT, index, now, now);
+        state->repeat_count++;
+        esp_timer_start_once(state->timer, GESTURE_REPEAT_PERIOD_MS * 1000);
+    }
+    else if(gesture_config[index].holds)
+    {
+        state->holds_reported++;
+        if(state->holds_reported == 1)
+        {
+            send_gesture(BUTTON_GESTURE_HOLD_3S, index, now, now);
+            esp_timer_start_once(state->timer, (GESTURE_SECOND_HOLD_MS - GESTURE_FIRST_HOLD_MS) * 1000);
+        }
+        else
+        {
+            send_gesture(BUTTON_GESTURE_HOLD_10S, index, now, now);
+        }
+    }
+}
+
+/**********************************
+ * @brief A press becomes a chord if another button is already held, a double-click if it follows a short press
+ *        closely enough, or otherwise a plain press that starts the hold or repeat timer
+ *********************************/
+static void handle_gesture_press(int index, const button_event_t *event)
+{
+    button_gesture_state_t *state = &gesture_state[index];
+
+    state->pressed = true;
+    state->consumed = false;
+    state->holds_reported = 0;
+    state->repeat_count = 0;
+
+    for(int other = 0; other < GESTURE_BUTTON_COUNT; other++)
+    {
+        if(other == index || !gesture_state[other].pressed || gesture_state[other].consumed)
+        {
+            continue;
+        }
+        // The held button already reported its press, both are now used up so neither holds, repeats or reports
+        // a short press on release
+        esp_timer_stop(gesture_state[other].timer);
+        gesture_state[other].consumed = true;
+        state->consumed = true;
+
+        button_gesture_t gesture = {
+            .type = BUTTON_GESTURE_CHORD,
+            .button_id = gesture_config[index].button_id,
+            .chord_button_id = gesture_config[other].button_id,
+            .isr_time_us = event->isr_time_us,
+            .debounced_time_us = event->debounced_time_us,
+        };
+        if(xQueueSend(user_button_queue, &gesture, 0) != pdTRUE)
+        {
+            ESP_LOGE(TAG, "Button queue full, dropped chord for GPIO %d", gesture.button_id);
+        }
+        return;
+    }
+
+    if(gesture_config[index].double_click && state->last_short_release_us != 0 &&
+       (event->isr_time_us - state->last_short_release_us) <= GESTURE_DOUBLE_CLICK_MS * 1000)
+    {
+        state->consumed = true;
+        state->last_short_release_us = 0;
+        send_gesture(BUTTON_GESTURE_DOUBLE_CLICK, index, event->isr_time_us, event->debounced_time_us);
+        return;
+    }
+
+    send_gesture(BUTTON_GESTURE_PRESS, index, event->isr_time_us, event->debounced_time_us);
+    if(gesture_config[index].repeats)
+    {
+        esp_timer_start_once(state->timer, GESTURE_REPEAT_DELAY_MS * 1000);
+    }
+    else if(gesture_config[index].holds)
+    {
+        esp_timer_start_once(state->timer, GESTURE_FIRST_HOLD_MS * 1000);
+    }
+}
+
+/**********************************
+ * @brief A release reports how far the press got: a short press, or the longest hold that was reached
+ *********************************/
+static void handle_gesture_release(int index, const button_event_t *event)
+{
+    button_gesture_state_t *state = &gesture_state[index];
+
+    if(!state->pressed)  // Held since boot, its press was never reported
+    {
+        return;
+    }
+    esp_timer_stop(state->timer);
+    state->pressed = false;
+    state->last_short_release_us = 0;
+
+    if(state->consumed)
+    {
+        state->consumed = false;
+        return;
+    }
+
+    if(state->holds_reported == 1)
+    {
+        send_gesture(BUTTON_GESTURE_HOLD_3S_RELEASED, index, event->isr_time_us, event->debounced_time_us);
+    }
+    else if(state->holds_reported >= 2)
+    {
+        send_gesture(BUTTON_GESTURE_HOLD_10S_RELEASED, index, event->isr_time_us, event->debounced_time_us);
+    }
+    else if(state->repeat_count == 0)
+    {
+        send_gesture(BUTTON_GESTURE_SHORT_PRESS, index, event->isr_time_us, event->debounced_time_us);
+        state->last_short_release_us = event->isr_time_us;
+    }
+}
+
+/**********************************
+ * @brief Called by the debouncer with every settled press and release. Runs in the esp_timer task
+ *********************************/
+void button_gestures_handle_event(const button_event_t *event)
+{
+    int index = get_gesture_index(event->button_id);
+    if(index < 0)
+    {
+        return;
+    }
+
+    if(event->type == BUTTON_EVENT_PRESS)
+    {
+        handle_gesture_press(index, event);
+    }
+    else
+    {
+        handle_gesture_release(index, event);
+    }
+}
+
+/**********************************
+ * @brief Gestures that come from an edge have a real ISR time and can be timed to the screen, timed ones cannot
+ *********************************/
+bool is_edge_gesture(const button_gesture_t *gesture)
+{
+    return gesture->type == BUTTON_GESTURE_PRESS || gesture->type == BUTTON_GESTURE_DOUBLE_CLICK ||
+           gesture->type == BUTTON_GESTURE_CHORD;
+}
+
+/**********************************
+ * @brief Creates the one-shot timer for each button. A button already held at boot, like the power button that woke
+ *        the device, is not reported until it has been released and pressed again, the same as the debouncer
+ *********************************/
+void button_gestures_init()
+{
+    for(int i = 0; i < GESTURE_BUTTON_COUNT; i++)
+    {
+        const esp_timer_create_args_t timer_args = {
+            .callback = gesture_timer_callback,
+            .arg = (void*)(uintptr_t)i,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "button_gesture",
+        };
+        ESP_ERROR_CHECK(esp_timer_create(&timer_args, &gesture_state[i].timer));
+    }
+}
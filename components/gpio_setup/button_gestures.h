@@ -0,0 +1,43 @@
+#ifndef BUTTON_GESTURES_H
+#define BUTTON_GESTURES_H
+
+#include "stdint.h"
+#include "stdbool.h"
+#include "Userbuttons.h"
+
+#define GESTURE_FIRST_HOLD_MS      3000   // Power button sleep hold
+#define GESTURE_SECOND_HOLD_MS     10000  // Power button power off hold
+#define GESTURE_DOUBLE_CLICK_MS    400    // Longest gap between a release and the next press for a double-click
+#define GESTURE_REPEAT_DELAY_MS    500    // Hold time before a repeating button starts repeating
+#define GESTURE_REPEAT_PERIOD_MS   50
+
+typedef enum {
+    BUTTON_GESTURE_PRESS = 0,           // Sent as soon as a press settles, for actions that should not wait on the release
+    BUTTON_GESTURE_SHORT_PRESS,         // Released before any hold or repeat was reported
+    BUTTON_GESTURE_DOUBLE_CLICK,        // Pressed again right after a short press, sent instead of a second PRESS
+    BUTTON_GESTURE_HOLD_3S,             // Still held after GESTURE_FIRST_HOLD_MS
+    BUTTON_GESTURE_HOLD_10S,            // Still held after GESTURE_SECOND_HOLD_MS
+    BUTTON_GESTURE_HOLD_3S_RELEASED,    // Released after the 3s hold but before the 10s hold
+    BUTTON_GESTURE_HOLD_10S_RELEASED,   // Released after the 10s hold
+    BUTTON_GESTURE_REPEAT,              // Sent every GESTURE_REPEAT_PERIOD_MS while a repeating button is held
+    BUTTON_GESTURE_CHORD                // Pressed while another button was held, sent instead of a PRESS
+} button_gesture_type_t;
+
+/************************************
+ * What the gesture recognizer puts on user_button_queue. Gestures that come straight from an edge keep the edge
+ * times so the press can be timed to the screen, timed gestures carry the time the timer fired
+ ***********************************/
+typedef struct {
+    button_gesture_type_t type;
+    int button_id;
+    int chord_button_id;        // For chords, the button that was already held
+    uint32_t repeat_count;      // For repeats, how many came before this one while the button stayed held
+    int64_t isr_time_us;
+    int64_t debounced_time_us;
+} button_gesture_t;
+
+void button_gestures_init();
+void button_gestures_handle_event(const button_event_t *event);
+bool is_edge_gesture(const button_gesture_t *gesture);
+
+#endif  // BUTTON_GESTURES_H
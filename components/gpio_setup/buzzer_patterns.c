@@ -0,0 +1,340 @@
+#include "buzzer_patterns.h"
+#include "Userbuttons.h"
+#include "driver/ledc.h"
+#include "driver/gpio.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "wake_lock.h"
+#include "power_mode.h"
+
+static const char *TAG = "BUZZER";
+
+// SOS timing, a dot is one unit
+#define SOS_UNIT_MS  150
+// Quiet time before the user alarm chirps again, so it keeps reminding without sounding constantly
+#define CHIRP_REPEAT_GAP_MS  30000
+
+#define LEDC_OUTPUT_PIN 12
+#define LEDC_FREQUENCY 490
+
+static const buzzer_step_t beep_steps[] = {
+    { .duty = BUZZER_FULL_DUTY, .hold_ms = 120 },
+    { .duty = 0,                .hold_ms = 0 },
+};
+
+static const buzzer_step_t double_beep_steps[] = {
+    { .duty = BUZZER_FULL_DUTY, .hold_ms = 80 },
+    { .duty = 0,                .hold_ms = 80 },
+    { .duty = BUZZER_FULL_DUTY, .hold_ms = 80 },
+    { .duty = 0,                .hold_ms = 0 },
+};
+
+// Each chirp swells up with a hardware fade, and they get louder and closer together. The burst repeats after a long
+// quiet gap until the alarm is acknowledged or clears
+static const buzzer_step_t escalating_chirp_steps[] = {
+    { .duty = BUZZER_FULL_DUTY / 4, .fade_ms = 60, .hold_ms = 100 },
+    { .duty = 0,                    .hold_ms = 300 },
+    { .duty = BUZZER_FULL_DUTY / 2, .fade_ms = 60, .hold_ms = 100 },
+    { .duty = 0,                    .hold_ms = 200 },
+    { .duty = BUZZER_FULL_DUTY,     .fade_ms = 60, .hold_ms = 100 },
+    { .duty = 0,                    .hold_ms = 100 },
+    { .duty = BUZZER_FULL_DUTY,     .fade_ms = 60, .hold_ms = 100 },
+    { .duty = 0,                    .hold_ms = CHIRP_REPEAT_GAP_MS },
+};
+
+static const buzzer_step_t sos_steps[] = {
+    { .duty = 1, .hold_ms = SOS_UNIT_MS },     { .duty = 0, .hold_ms = SOS_UNIT_MS },
+    { .duty = 1, .hold_ms = SOS_UNIT_MS },     { .duty = 0, .hold_ms = SOS_UNIT_MS },
+    { .duty = 1, .hold_ms = SOS_UNIT_MS },     { .duty = 0, .hold_ms = 3 * SOS_UNIT_MS },
+    { .duty = 1, .hold_ms = 3 * SOS_UNIT_MS }, { .duty = 0, .hold_ms = SOS_UNIT_MS },
+    { .duty = 1, .hold_ms = 3 * SOS_UNIT_MS }, { .duty = 0, .hold_ms = SOS_UNIT_MS },
+    { .duty = 1, .hold_ms = 3 * SOS_UNIT_MS }, { .duty = 0, .hold_ms = 3 * SOS_UNIT_MS },
+    { .duty = 1, .hold_ms = SOS_UNIT_MS },     { .duty = 0, .hold_ms = SOS_UNIT_MS },
+    { .duty = 1, .hold_ms = SOS_UNIT_MS },     { .duty = 0, .hold_ms = SOS_UNIT_MS },
+    { .duty = 1, .hold_ms = SOS_UNIT_MS },     { .duty = 0, .hold_ms = 7 * SOS_UNIT_MS },
+};
+
+#define PATTERN(step_array, repeats)  { .steps = step_array, .step_count = sizeof(step_array) / sizeof(step_array[0]), .repeat = repeats }
+
+static const buzzer_pattern_t buzzer_patterns[BUZZER_PATTERN_COUNT] = {
+    [BUZZER_PATTERN_BEEP]              = PATTERN(beep_steps, false),
+    [BUZZER_PATTERN_DOUBLE_BEEP]       = PATTERN(double_beep_steps, false),
+    [BUZZER_PATTERN_ESCALATING_CHIRPS] = PATTERN(escalating_chirp_steps, true),
+    [BUZZER_PATTERN_SOS]               = PATTERN(sos_steps, true),
+};
+
+/************************************
+ * Playback state for one buzzer
+ ***********************************/
+typedef struct {
+    esp_timer_handle_t timer;       // One-shot, fires when the next step is due
+    const buzzer_pattern_t *pattern;
+    uint8_t step;
+    bool playing;
+    bool wake_locked;   // One-shot patterns keep the device awake until they finish
+    bool power_locked;  // The user buzzer keeps the APB clock up while it sounds, the LEDC runs off it
+} buzzer_state_t;
+
+static buzzer_state_t buzzer_state[BUZZER_COUNT];
+static SemaphoreHandle_t buzzer_mutex = NULL;
+static bool user_buzzer_pwm_ready = false;
+
+/**********************************
+ * @brief Sets up the LEDC timer, channel and fade service for the user buzzer. Most wakes never sound it, so this
+ *        only runs the first time it plays. Called with buzzer_mutex held
+ * @returns false if the LEDC could not be set up
+ *********************************/
+static bool user_buzzer_pwm_init()
+{
+    if(user_buzzer_pwm_ready)
+    {
+        return true;
+    }
+
+    ledc_timer_config_t ledc_timer = {
+        .timer_num = LEDC_TIMER_0,
+        .duty_resolution = LEDC_TIMER_13_BIT, // 13-bit resolution
+        .freq_hz = LEDC_FREQUENCY,            // Set frequency - Audrey previously tested with this f on Arduino
+        .clk_cfg = LEDC_AUTO_CLK,
+        .speed_mode = LEDC_LOW_SPEED_MODE
+    };
+    ledc_channel_config_t pwm_conf = {
+        .duty = 0,  // Begin at zero on startup
+        .gpio_num = LEDC_OUTPUT_PIN,
+        .channel = LEDC_CHANNEL_0,
+        .speed_mode = LEDC_LOW_SPEED_MODE
+    };
+
+    esp_err_t err = ledc_timer_config(&ledc_timer);
+    if(err == ESP_OK)
+    {
+        err = ledc_channel_config(&pwm_conf);
+    }
+    if(err == ESP_OK)
+    {
+        err = ledc_fade_func_install(0);  // Needed for the hardware fades the patterns use
+    }
+    if(err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Error setting up buzzer PWM: %s", esp_err_to_name(err));
+        return false;
+    }
+    user_buzzer_pwm_ready = true;
+    return true;
+}
+
+/**********************************
+ * @brief Sets a buzzer's output for a step. The user buzzer fades in hardware, so nothing runs until the next step.
+ *        A user buzzer that was never set up is already silent, so it is only set up for a step that makes sound
+ *********************************/
+static void apply_buzzer_step(buzzer_t buzzer, const buzzer_step_t *step)
+{
+    esp_err_t err = ESP_OK;
+
+    if(buzzer == BUZZER_SAFETY)
+    {
+        gpio_set_level(LARGE_BUZZER_PIN, step->duty > 0 ? 1 : 0);
+        return;
+    }
+
+    if(!user_buzzer_pwm_ready && (step->duty == 0 || !user_buzzer_pwm_init()))
+    {
+        return;
+    }
+    if(step->fade_ms > 0)
+    {
+        err = ledc_set_fade_time_and_start(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0, step->duty, step->fade_ms, LEDC_FADE_NO_WAIT);
+    }
+    else
+    {
+        err = ledc_set_duty_and_update(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0, step->duty, 0);
+    }
+    if(err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Error setting buzzer duty: %s", esp_err_to_name(err));
+    }
+}
+
+/**********************************
+ * @brief Takes or gives up the buzzer wake lock for one buzzer. Called with buzzer_mutex held
+ *********************************/
+static void set_buzzer_wake_lock(buzzer_state_t *state, bool locked)
+{
+    if(locked && !state->wake_locked)
+    {
+        wake_lock_acquire(WAKE_LOCK_BUZZER);
+    }
+    else if(!locked && state->wake_locked)
+    {
+        wake_lock_release(WAKE_LOCK_BUZZER);
+    }
+    state->wake_locked = locked;
+}
+
+/**********************************
+ * @brief Takes or gives up the buzzer power lock while the user buzzer sounds. It is given up on the quiet steps, so a
+ *        repeating pattern's gaps can be spent in light sleep. The large buzzer is a plain pin and keeps its level
+ *        through light sleep, so it does not need one. Called with buzzer_mutex held
+ *********************************/
+static void set_buzzer_power_lock(buzzer_t buzzer, bool locked)
+{
+    buzzer_state_t *state = &buzzer_state[buzzer];
+
+    if(buzzer != BUZZER_USER || locked == state->power_locked)
+    {
+        return;
+    }
+    if(locked)
+    {
+        power_lock_acquire(POWER_LOCK_BUZZER);
+    }
+    else
+    {
+        power_lock_release(POWER_LOCK_BUZZER);
+    }
+    state->power_locked = locked;
+}
+
+/**********************************
+ * @brief Applies the buzzer's current step and arms the timer for the next one. Called with buzzer_mutex held
+ *********************************/
+static void start_buzzer_step(buzzer_t buzzer)
+{
+    buzzer_state_t *state = &buzzer_state[buzzer];
+    const buzzer_step_t *step = &state->pattern->steps[state->step];
+
+    set_buzzer_power_lock(buzzer, step->duty > 0 || step->fade_ms > 0);
+    apply_buzzer_step(buzzer, step);
+    esp_timer_start_once(state->timer, (uint64_t)step->hold_ms * 1000);
+}
+
+/**********************************
+ * @brief Fires when a step is over. Moves on to the next step, starts over if the pattern repeats, or goes quiet
+ *********************************/
+static void buzzer_timer_callback(void *arg)
+{
+    buzzer_t buzzer = (buzzer_t)(uintptr_t)arg;
+    buzzer_state_t *state = &buzzer_state[buzzer];
+
+    xSemaphoreTake(buzzer_mutex, portMAX_DELAY);
+    if(state->playing)  // Not stopped while this callback was waiting
+    {
+        state->step++;
+        if(state->step >= state->pattern->step_count)
+        {
+            state->step = 0;
+            state->playing = state->pattern->repeat;
+        }
+
+        if(state->playing)
+        {
+            start_buzzer_step(buzzer);
+        }
+        else
+        {
+            apply_buzzer_step(buzzer, &(buzzer_step_t){ .duty = 0 });
+            set_buzzer_wake_lock(state, false);
+            set_buzzer_power_lock(buzzer, false);
+        }
+    }
+    xSemaphoreGive(buzzer_mutex);
+}
+
+/**********************************
+ * @brief Starts a pattern on a buzzer, replacing whatever it was playing
+ *********************************/
+void buzzer_play(buzzer_t buzzer, buzzer_pattern_id_t pattern)
+{
+    if(buzzer >= BUZZER_COUNT || pattern >= BUZZER_PATTERN_COUNT)
+    {
+        return;
+    }
+
+    xSemaphoreTake(buzzer_mutex, portMAX_DELAY);
+    buzzer_state_t *state = &buzzer_state[buzzer];
+    esp_timer_stop(state->timer);
+    state->pattern = &buzzer_patterns[pattern];
+    state->step = 0;
+    state->playing = true;
+    set_buzzer_wake_lock(state, !state->pattern->repeat);
+    start_buzzer_step(buzzer);
+    xSemaphoreGive(buzzer_mutex);
+}
+
+/**********************************
+ * @brief Silences a buzzer right away
+ *********************************/
+void buzzer_stop(buzzer_t buzzer)
+{
+    if(buzzer >= BUZZER_COUNT)
+    {
+        return;
+    }
+
+    xSemaphoreTake(buzzer_mutex, portMAX_DELAY);
+    esp_timer_stop(buzzer_state[buzzer].timer);
+    buzzer_state[buzzer].playing = false;
+    apply_buzzer_step(buzzer, &(buzzer_step_t){ .duty = 0 });
+    set_buzzer_wake_lock(&buzzer_state[buzzer], false);
+    set_buzzer_power_lock(buzzer, false);
+    xSemaphoreGive(buzzer_mutex);
+}
+
+bool is_buzzer_playing(buzzer_t buzzer)
+{
+    return buzzer < BUZZER_COUNT && buzzer_state[buzzer].playing;
+}
+
+/**********************************
+ * @brief Called right before deep sleep. One-shot patterns hold the buzzer wake lock until they finish, so anything
+ *        still playing here repeats. The LEDC does not run in deep sleep, so the user buzzer is silenced, and the
+ *        alarm rules start its pattern again when they first run after the wake. A large buzzer that is sounding is
+ *        latched on with the pin hold, so the alarm keeps going steadily while the device sleeps
+ *********************************/
+void buzzer_prepare_for_sleep()
+{
+    bool safety_on = is_buzzer_playing(BUZZER_SAFETY);
+
+    buzzer_stop(BUZZER_USER);
+    buzzer_stop(BUZZER_SAFETY);
+    if(safety_on)
+    {
+        gpio_set_level(LARGE_BUZZER_PIN, 1);
+        gpio_hold_en(LARGE_BUZZER_PIN);
+        gpio_deep_sleep_hold_en();
+    }
+}
+
+/**********************************
+ * @brief Configures the large buzzer pin, creates the step timers and releases a large buzzer latched on over the last
+ *        deep sleep. The user buzzer PWM is set up the first time it plays
+ *********************************/
+void buzzer_patterns_init()
+{
+    buzzer_mutex = xSemaphoreCreateMutex();
+
+    gpio_config_t lrg_bzr_pin_config = {
+        .mode = GPIO_MODE_OUTPUT,
+        .intr_type = GPIO_INTR_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .pull_up_en   = GPIO_PULLUP_DISABLE,
+        .pin_bit_mask = (1ULL << LARGE_BUZZER_PIN)
+    };
+    gpio_config(&lrg_bzr_pin_config);
+    gpio_hold_dis(LARGE_BUZZER_PIN);
+    gpio_deep_sleep_hold_dis();
+    gpio_set_level(LARGE_BUZZER_PIN, 0);
+
+    for(uint8_t i = 0; i < BUZZER_COUNT; i++)
+    {
+        const esp_timer_create_args_t timer_args = {
+            .callback = buzzer_timer_callback,
+            .arg = (void*)(uintptr_t)i,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "buzzer_step",
+        };
+        ESP_ERROR_CHECK(esp_timer_create(&timer_args, &buzzer_state[i].timer));
+    }
+}
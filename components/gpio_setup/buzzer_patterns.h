@@ -0,0 +1,46 @@
+#ifndef BUZZER_PATTERNS_H
+#define BUZZER_PATTERNS_H
+
+#include "stdint.h"
+#include "stdbool.h"
+
+// 50% duty on the 13 bit LEDC timer the user buzzer runs on, its loudest setting
+#define BUZZER_FULL_DUTY  4096
+
+/************************************
+ * One step of a pattern. The step starts a hardware fade (or a jump when fade_ms is 0) to its duty, and the next
+ * step starts hold_ms after this one did, so hold_ms has to be at least fade_ms
+ ***********************************/
+typedef struct {
+    uint16_t duty;      // User buzzer duty, the large buzzer is on for any non-zero duty
+    uint16_t fade_ms;
+    uint16_t hold_ms;
+} buzzer_step_t;
+
+typedef struct {
+    const buzzer_step_t *steps;
+    uint8_t step_count;
+    bool repeat;        // Start over after the last step instead of going quiet
+} buzzer_pattern_t;
+
+typedef enum {
+    BUZZER_PATTERN_BEEP = 0,
+    BUZZER_PATTERN_DOUBLE_BEEP,
+    BUZZER_PATTERN_ESCALATING_CHIRPS,   // User threshold alarm
+    BUZZER_PATTERN_SOS,                 // Large buzzer safety alarm
+    BUZZER_PATTERN_COUNT
+} buzzer_pattern_id_t;
+
+typedef enum {
+    BUZZER_USER = 0,    // Piezo on the LEDC output
+    BUZZER_SAFETY,      // Large buzzer on LARGE_BUZZER_PIN
+    BUZZER_COUNT
+} buzzer_t;
+
+void buzzer_patterns_init();
+void buzzer_play(buzzer_t buzzer, buzzer_pattern_id_t pattern);
+void buzzer_stop(buzzer_t buzzer);
+bool is_buzzer_playing(buzzer_t buzzer);
+void buzzer_prepare_for_sleep();
+
+#endif  // BUZZER_PATTERNS_H
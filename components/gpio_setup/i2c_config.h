@@ -10,6 +10,7 @@
 #include "driver/i2c_master.h"
 
 void i2c_master_config(void);
+void i2c_display_device_init(void);
 
 extern i2c_master_bus_handle_t i2c_bus_handle;
 
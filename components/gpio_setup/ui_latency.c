@@ -0,0 +1,174 @@
+#include "ui_latency.h"
+#include "string.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "UI_LATENCY";
+
+static const char *stage_names[UI_LATENCY_STAGE_COUNT] = {
+    [UI_LATENCY_DEBOUNCE]    = "debounce",
+    [UI_LATENCY_QUEUE_WAIT]  = "queue wait",
+    [UI_LATENCY_DISPATCH]    = "dispatch",
+    [UI_LATENCY_RENDER_WAIT] = "render wait",
+    [UI_LATENCY_RENDER]      = "render",
+    [UI_LATENCY_TOTAL]       = "total",
+};
+
+// Only kept in RAM, the numbers are for the current session
+static ui_latency_histogram_t histograms[UI_LATENCY_STAGE_COUNT];
+static portMUX_TYPE latency_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/************************************
+ * The press the button task is currently handling. Render requests made by that task during handling are tagged
+ * with the press's ISR time so the render task can close the measurement
+ ***********************************/
+static struct {
+    bool active;
+    bool render_requested;
+    int64_t isr_time_us;
+    int64_t stage_start_us;
+    TaskHandle_t task;
+} current_input;
+
+/**********************************
+ * @brief Adds one duration to a stage's histogram
+ *********************************/
+void ui_latency_record(ui_latency_stage_t stage, int64_t duration_us)
+{
+    if(stage >= UI_LATENCY_STAGE_COUNT)
+    {
+        return;
+    }
+    uint32_t duration = (duration_us <= 0) ? 0 : (duration_us > UINT32_MAX) ? UINT32_MAX : (uint32_t)duration_us;
+    uint8_t bucket = (duration == 0) ? 0 : 31 - __builtin_clz(duration);
+    if(bucket >= UI_LATENCY_BUCKETS)
+    {
+        bucket = UI_LATENCY_BUCKETS - 1;
+    }
+
+    taskENTER_CRITICAL(&latency_lock);
+    histograms[stage].count++;
+    histograms[stage].bucket[bucket]++;
+    if(duration > histograms[stage].max_us)
+    {
+        histograms[stage].max_us = duration;
+    }
+    taskEXIT_CRITICAL(&latency_lock);
+}
+
+/**********************************
+ * @brief Called by the button task when it takes a press off the queue
+ * @param isr_time_us is the esp_timer time of the first edge of the press
+ * @param debounced_time_us is when the debouncer settled on the press
+ *********************************/
+void ui_latency_begin_input(int64_t isr_time_us, int64_t debounced_time_us)
+{
+    int64_t now = esp_timer_get_time();
+    ui_latency_record(UI_LATENCY_DEBOUNCE, debounced_time_us - isr_time_us);
+    ui_latency_record(UI_LATENCY_QUEUE_WAIT, now - debounced_time_us);
+
+    current_input.isr_time_us = isr_time_us;
+    current_input.stage_start_us = now;
+    current_input.render_requested = false;
+    current_input.task = xTaskGetCurrentTaskHandle();
+    current_input.active = true;
+}
+
+/**********************************
+ * @brief Called when a render is requested. Only the first render requested by the button task while it handles a
+ *        press counts, renders requested by other tasks are not user input
+ * @returns the ISR time of the press to carry with the render, or 0 if the render is not from a press
+ *********************************/
+int64_t ui_latency_note_render_request()
+{
+    if(!current_input.active || current_input.render_requested || current_input.task != xTaskGetCurrentTaskHandle())
+    {
+        return 0;
+    }
+    current_input.render_requested = true;
+    ui_latency_record(UI_LATENCY_DISPATCH, esp_timer_get_time() - current_input.stage_start_us);
+    return current_input.isr_time_us;
+}
+
+void ui_latency_end_input()
+{
+    current_input.active = false;
+}
+
+/**********************************
+ * @brief Called by the render task once a frame that came from a press is on the display
+ * @param input_time_us is the ISR time carried with the render request
+ * @param request_time_us is when the render was requested
+ * @param start_time_us is when the render task started drawing
+ *********************************/
+void ui_latency_render_done(int64_t input_time_us, int64_t request_time_us, int64_t start_time_us)
+{
+    int64_t now = esp_timer_get_time();
+
+    ui_latency_record(UI_LATENCY_RENDER_WAIT, start_time_us - request_time_us);
+    ui_latency_record(UI_LATENCY_RENDER, now - start_time_us);
+    ui_latency_record(UI_LATENCY_TOTAL, now - input_time_us);
+
+    if(histograms[UI_LATENCY_TOTAL].count % UI_LATENCY_REPORT_INTERVAL == 0)
+    {
+        ui_latency_log_report();
+    }
+}
+
+/**********************************
+ * @brief Copies a stage's histogram, for a diagnostics page or endpoint
+ * @returns false if the stage does not exist
+ *********************************/
+bool ui_latency_get_histogram(ui_latency_stage_t stage, ui_latency_histogram_t *histogram)
+{
+    if(stage >= UI_LATENCY_STAGE_COUNT || histogram == NULL)
+    {
+        return false;
+    }
+    taskENTER_CRITICAL(&latency_lock);
+    *histogram = histograms[stage];
+    taskEXIT_CRITICAL(&latency_lock);
+    return true;
+}
+
+/**********************************
+ * @brief Gets the upper edge of the bucket holding the given fraction of samples, in microseconds
+ *********************************/
+static uint32_t histogram_percentile(const ui_latency_histogram_t *histogram, uint32_t percent)
+{
+    uint32_t target = (histogram->count * percent + 99) / 100;
+    uint32_t seen = 0;
+
+    for(uint8_t i = 0; i < UI_LATENCY_BUCKETS; i++)
+    {
+        seen += histogram->bucket[i];
+        if(seen >= target)
+        {
+            return (i == UI_LATENCY_BUCKETS - 1) ? histogram->max_us : (2u << i);
+        }
+    }
+    return histogram->max_us;
+}
+
+/**********************************
+ * @brief Logs the sample count, median, 95th percentile and max of each stage. Percentiles are bucket upper edges,
+ *        so they are accurate to within a factor of two
+ *********************************/
+void ui_latency_log_report()
+{
+    ui_latency_histogram_t histogram;
+
+    for(uint8_t stage = 0; stage < UI_LATENCY_STAGE_COUNT; stage++)
+    {
+        ui_latency_get_histogram(stage, &histogram);
+        if(histogram.count == 0)
+        {
+            continue;
+        }
+        ESP_LOGI(TAG, "%-11s n=%lu p50<=%luus p95<=%luus max=%luus", stage_names[stage], (unsigned long)histogram.count,
+                 (unsigned long)histogram_percentile(&histogram, 50), (unsigned long)histogram_percentile(&histogram, 95),
+                 (unsigned long)histogram.max_us);
+    }
+}
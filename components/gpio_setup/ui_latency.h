@@ -0,0 +1,39 @@
+#ifndef UI_LATENCY_H
+#define UI_LATENCY_H
+
+#include "stdint.h"
+#include "stdbool.h"
+
+// Bucket i counts durations from 2^i up to 2^(i+1) microseconds, the last bucket also takes anything longer
+#define UI_LATENCY_BUCKETS          24
+// A report is logged each time this many button presses have made it to the screen
+#define UI_LATENCY_REPORT_INTERVAL  20
+
+/************************************
+ * Stages between a button edge and the resulting frame being on the display
+ ***********************************/
+typedef enum {
+    UI_LATENCY_DEBOUNCE = 0,    // First edge until the debouncer settles on the press
+    UI_LATENCY_QUEUE_WAIT,      // Settled until the button task takes the press off user_button_queue
+    UI_LATENCY_DISPATCH,        // Dequeued until handle_button_press asks for a render
+    UI_LATENCY_RENDER_WAIT,     // Render requested until the render task starts on it
+    UI_LATENCY_RENDER,          // Drawing and sending the frame
+    UI_LATENCY_TOTAL,           // ISR until the frame is on the display
+    UI_LATENCY_STAGE_COUNT
+} ui_latency_stage_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t max_us;
+    uint32_t bucket[UI_LATENCY_BUCKETS];
+} ui_latency_histogram_t;
+
+void ui_latency_record(ui_latency_stage_t stage, int64_t duration_us);
+void ui_latency_begin_input(int64_t isr_time_us, int64_t debounced_time_us);
+int64_t ui_latency_note_render_request();
+void ui_latency_end_input();
+void ui_latency_render_done(int64_t input_time_us, int64_t request_time_us, int64_t start_time_us);
+bool ui_latency_get_histogram(ui_latency_stage_t stage, ui_latency_histogram_t *histogram);
+void ui_latency_log_report();
+
+#endif  // UI_LATENCY_H
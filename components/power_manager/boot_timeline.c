@@ -0,0 +1,63 @@
+#include "boot_timeline.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "esp_sleep.h"
+#include "esp_log.h"
+
+static const char *TAG = "BOOT_TIMELINE";
+
+static const char *boot_event_names[BOOT_EVENT_COUNT] = {
+    [BOOT_EVENT_APP_MAIN]           = "app_main",
+    [BOOT_EVENT_CORE_READY]         = "core ready",
+    [BOOT_EVENT_UI_READY]           = "ui ready",
+    [BOOT_EVENT_TASKS_STARTED]      = "tasks started",
+    [BOOT_EVENT_FIRST_I2C_COMMAND]  = "first i2c",
+};
+
+// When each event was reached this wake, 0 if it was not
+static int64_t boot_event_time_us[BOOT_EVENT_COUNT];
+static portMUX_TYPE boot_timeline_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**********************************
+ * @brief Records the time an event was first reached. The esp_timer starts early in the startup code, so the times
+ *        leave out the ROM and second stage bootloader, which take the same time on every wake
+ *********************************/
+void boot_timeline_mark(boot_event_t event)
+{
+    if(event >= BOOT_EVENT_COUNT)
+    {
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    taskENTER_CRITICAL(&boot_timeline_lock);
+    if(boot_event_time_us[event] == 0)
+    {
+        boot_event_time_us[event] = now;
+    }
+    taskEXIT_CRITICAL(&boot_timeline_lock);
+}
+
+/**********************************
+ * @returns when the event was reached this wake, 0 if it was not
+ *********************************/
+int64_t boot_timeline_get_time_us(boot_event_t event)
+{
+    return event < BOOT_EVENT_COUNT ? boot_event_time_us[event] : 0;
+}
+
+/**********************************
+ * @brief Logs the events reached this wake in order, along with what woke the device, since timer wakes skip the
+ *        display and button setup
+ *********************************/
+void boot_timeline_log_report()
+{
+    ESP_LOGI(TAG, "Wake cause %d", esp_sleep_get_wakeup_cause());
+    for(uint8_t i = 0; i < BOOT_EVENT_COUNT; i++)
+    {
+        if(boot_event_time_us[i] != 0)
+        {
+            ESP_LOGI(TAG, "%-13s at %5lu us", boot_event_names[i], (unsigned long)boot_event_time_us[i]);
+        }
+    }
+}
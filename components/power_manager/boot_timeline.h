@@ -0,0 +1,23 @@
+#ifndef BOOT_TIMELINE_H
+#define BOOT_TIMELINE_H
+
+#include "stdint.h"
+
+/************************************
+ * Points on the way from reset to the first measurement. Each one is only recorded the first time it is reached in a
+ * wake, so marking it again from another task costs nothing
+ ***********************************/
+typedef enum {
+    BOOT_EVENT_APP_MAIN = 0,        // app_main started
+    BOOT_EVENT_CORE_READY,          // Wake locks, I2C bus and sensors set up
+    BOOT_EVENT_UI_READY,            // Display and buttons set up, interactive wakes only
+    BOOT_EVENT_TASKS_STARTED,       // Every task for this wake created
+    BOOT_EVENT_FIRST_I2C_COMMAND,   // First command sent to a sensor
+    BOOT_EVENT_COUNT
+} boot_event_t;
+
+void boot_timeline_mark(boot_event_t event);
+int64_t boot_timeline_get_time_us(boot_event_t event);
+void boot_timeline_log_report();
+
+#endif  // BOOT_TIMELINE_H
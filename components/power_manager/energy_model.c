@@ -0,0 +1,59 @@
+#include "energy_model.h"
+
+/************************************
+ * Typical ESP32-S2 currents from the datasheet, in uA. The sensors and display draw the same in every mode, so they
+ * are left out. Replace these with bench measurements of the board when there are some
+ ***********************************/
+#define ACTIVE_CURRENT_UA       19000   // CPU at 160 MHz, radio off
+#define LIGHT_SLEEP_CURRENT_UA  750
+#define DEEP_SLEEP_CURRENT_UA   25      // RTC timer and RTC memory kept on
+
+// ROM, bootloader and startup before app_main on a wake from deep sleep, all at full clock
+#define BOOT_TIME_MS            300
+// CPU time a wake actually needs for I2C, averaging and drawing. The rest of the awake time is spent waiting on
+// sensor conversions, which is light sleep when power management is on
+#define BUSY_TIME_MS            50
+
+static const char *energy_mode_names[ENERGY_MODE_COUNT] = {
+    [ENERGY_MODE_DEEP_SLEEP]     = "deep sleep",
+    [ENERGY_MODE_DEEP_SLEEP_DFS] = "deep sleep+dfs",
+    [ENERGY_MODE_LIGHT_SLEEP]    = "light sleep",
+};
+
+/**********************************
+ * @brief Works out the average current of one wake cycle in a mode
+ * @param awake_ms is how long the firmware was running this wake, not counting the boot
+ * @param sleep_ms is how long until the next wake
+ *********************************/
+uint32_t energy_model_average_current_ua(energy_mode_t mode, uint32_t awake_ms, uint32_t sleep_ms)
+{
+    uint64_t busy_ms = awake_ms < BUSY_TIME_MS ? awake_ms : BUSY_TIME_MS;
+    uint64_t waiting_ms = awake_ms - busy_ms;
+    uint64_t charge = 0;  // uA * ms
+    uint64_t cycle_ms = (uint64_t)awake_ms + sleep_ms;
+
+    switch(mode)
+    {
+        case ENERGY_MODE_DEEP_SLEEP:
+            charge = (BOOT_TIME_MS + (uint64_t)awake_ms) * ACTIVE_CURRENT_UA + (uint64_t)sleep_ms * DEEP_SLEEP_CURRENT_UA;
+            cycle_ms += BOOT_TIME_MS;
+            break;
+        case ENERGY_MODE_DEEP_SLEEP_DFS:
+            charge = (BOOT_TIME_MS + busy_ms) * ACTIVE_CURRENT_UA + waiting_ms * LIGHT_SLEEP_CURRENT_UA +
+                     (uint64_t)sleep_ms * DEEP_SLEEP_CURRENT_UA;
+            cycle_ms += BOOT_TIME_MS;
+            break;
+        case ENERGY_MODE_LIGHT_SLEEP:
+            charge = busy_ms * ACTIVE_CURRENT_UA + (waiting_ms + sleep_ms) * LIGHT_SLEEP_CURRENT_UA;
+            break;
+        default:
+            return 0;
+    }
+
+    return cycle_ms == 0 ? 0 : (uint32_t)(charge / cycle_ms);
+}
+
+const char *energy_model_mode_name(energy_mode_t mode)
+{
+    return mode < ENERGY_MODE_COUNT ? energy_mode_names[mode] : "unknown";
+}
@@ -0,0 +1,19 @@
+#ifndef ENERGY_MODEL_H
+#define ENERGY_MODEL_H
+
+#include "stdint.h"
+
+/************************************
+ * The ways the device can spend a wake cycle
+ ***********************************/
+typedef enum {
+    ENERGY_MODE_DEEP_SLEEP = 0,     // Full clock while awake, deep sleep between wakes
+    ENERGY_MODE_DEEP_SLEEP_DFS,     // Clock scaled down and light sleep while waiting on sensors, deep sleep between wakes
+    ENERGY_MODE_LIGHT_SLEEP,        // Never deep sleeps, light sleeps between wakes as well
+    ENERGY_MODE_COUNT
+} energy_mode_t;
+
+uint32_t energy_model_average_current_ua(energy_mode_t mode, uint32_t awake_ms, uint32_t sleep_ms);
+const char *energy_model_mode_name(energy_mode_t mode);
+
+#endif  // ENERGY_MODEL_H
@@ -0,0 +1,114 @@
+#include "power_mode.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#ifdef CONFIG_PM_ENABLE
+#include "esp_pm.h"
+#endif
+
+static const char *TAG = "POWER_MODE";
+
+#ifdef CONFIG_PM_ENABLE
+typedef struct {
+    esp_pm_lock_type_t type;
+    const char *name;
+} power_lock_config_t;
+
+static const power_lock_config_t power_lock_config[POWER_LOCK_COUNT] = {
+    [POWER_LOCK_DISPLAY]    = { .type = ESP_PM_APB_FREQ_MAX,   .name = "display" },
+    [POWER_LOCK_BUZZER]     = { .type = ESP_PM_APB_FREQ_MAX,   .name = "buzzer" },
+    [POWER_LOCK_USER_INPUT] = { .type = ESP_PM_NO_LIGHT_SLEEP, .name = "user_input" },
+};
+
+static esp_pm_lock_handle_t power_locks[POWER_LOCK_COUNT];
+#endif
+
+/**********************************
+ * @brief Turns on dynamic frequency scaling, and automatic light sleep when tickless idle is on, then creates the
+ *        locks. Does nothing when power management is not enabled in the config
+ *********************************/
+void power_mode_init()
+{
+#ifdef CONFIG_PM_ENABLE
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = CONFIG_XTAL_FREQ,
+#ifdef CONFIG_FREERTOS_USE_TICKLESS_IDLE
+        .light_sleep_enable = true,
+#endif
+    };
+    esp_err_t err = esp_pm_configure(&pm_config);
+    if(err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Error configuring power management: %s", esp_err_to_name(err));
+    }
+
+    for(uint8_t i = 0; i < POWER_LOCK_COUNT; i++)
+    {
+        err = esp_pm_lock_create(power_lock_config[i].type, 0, power_lock_config[i].name, &power_locks[i]);
+        if(err != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Error creating %s power lock: %s", power_lock_config[i].name, esp_err_to_name(err));
+            power_locks[i] = NULL;
+        }
+    }
+#endif
+}
+
+/**********************************
+ * @brief Keeps the clock up and the device out of light sleep until the lock is released. The locks are counted,
+ *        so they can be taken more than once
+ *********************************/
+void power_lock_acquire(power_lock_id_t lock)
+{
+#ifdef CONFIG_PM_ENABLE
+    if(lock < POWER_LOCK_COUNT && power_locks[lock] != NULL)
+    {
+        esp_pm_lock_acquire(power_locks[lock]);
+    }
+#endif
+}
+
+void power_lock_release(power_lock_id_t lock)
+{
+#ifdef CONFIG_PM_ENABLE
+    if(lock < POWER_LOCK_COUNT && power_locks[lock] != NULL)
+    {
+        esp_pm_lock_release(power_locks[lock]);
+    }
+#endif
+}
+
+/**********************************
+ * @brief Picks how to wait for the next wake. Staying up in light sleep saves the boot, but draws more than deep sleep
+ *        while waiting, so it only wins when the wait is short. Only possible with automatic light sleep on
+ * @param awake_ms is how long this wake has been running
+ *********************************/
+energy_mode_t power_mode_choose(uint32_t awake_ms, uint64_t sleep_time_us)
+{
+#if defined(CONFIG_PM_ENABLE) && defined(CONFIG_FREERTOS_USE_TICKLESS_IDLE)
+    uint32_t sleep_ms = sleep_time_us / 1000;
+    if(energy_model_average_current_ua(ENERGY_MODE_LIGHT_SLEEP, awake_ms, sleep_ms) <
+       energy_model_average_current_ua(ENERGY_MODE_DEEP_SLEEP_DFS, awake_ms, sleep_ms))
+    {
+        return ENERGY_MODE_LIGHT_SLEEP;
+    }
+    return ENERGY_MODE_DEEP_SLEEP_DFS;
+#else
+    return ENERGY_MODE_DEEP_SLEEP;
+#endif
+}
+
+/**********************************
+ * @brief Logs the average current the energy model gives for this wake cycle in each mode, and the mode in use
+ *********************************/
+void power_mode_log_report(uint32_t awake_ms, uint64_t sleep_time_us)
+{
+    uint32_t sleep_ms = sleep_time_us / 1000;
+    for(uint8_t mode = 0; mode < ENERGY_MODE_COUNT; mode++)
+    {
+        ESP_LOGI(TAG, "%-14s %5lu uA average", energy_model_mode_name(mode),
+                 (unsigned long)energy_model_average_current_ua(mode, awake_ms, sleep_ms));
+    }
+    ESP_LOGI(TAG, "Awake %lu ms, next wake in %lu ms, using %s", (unsigned long)awake_ms, (unsigned long)sleep_ms,
+             energy_model_mode_name(power_mode_choose(awake_ms, sleep_time_us)));
+}
@@ -0,0 +1,25 @@
+#ifndef POWER_MODE_H
+#define POWER_MODE_H
+
+#include "stdint.h"
+#include "stdbool.h"
+#include "energy_model.h"
+
+/************************************
+ * Things that cannot run with the clock scaled down or through automatic light sleep. The I2C driver takes its own
+ * lock for each transfer, these cover what goes on between transfers
+ ***********************************/
+typedef enum {
+    POWER_LOCK_DISPLAY = 0,     // A frame is being sent, keep the clock up for the whole frame
+    POWER_LOCK_BUZZER,          // The user buzzer LEDC runs off the APB clock
+    POWER_LOCK_USER_INPUT,      // Button edges are missed in light sleep while the user is interacting
+    POWER_LOCK_COUNT
+} power_lock_id_t;
+
+void power_mode_init();
+void power_lock_acquire(power_lock_id_t lock);
+void power_lock_release(power_lock_id_t lock);
+energy_mode_t power_mode_choose(uint32_t awake_ms, uint64_t sleep_time_us);
+void power_mode_log_report(uint32_t awake_ms, uint64_t sleep_time_us);
+
+#endif  // POWER_MODE_H
@@ -0,0 +1,166 @@
+#include "wake_lock.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+
+static const char *TAG = "WAKE_LOCK";
+
+// Set while no lock is held, the deep sleep task waits on it
+#define WAKE_LOCKS_RELEASED_BIT  (1 << 0)
+
+static const char *wake_lock_names[WAKE_LOCK_COUNT] = {
+    [WAKE_LOCK_TEMP_HUMIDITY]   = "temp_humidity",
+    [WAKE_LOCK_CO2]             = "co2",
+    [WAKE_LOCK_VOC]             = "voc",
+    [WAKE_LOCK_USER_INTERACTION] = "user",
+    [WAKE_LOCK_BUZZER]          = "buzzer",
+    [WAKE_LOCK_DISPLAY]         = "display",
+};
+
+static uint8_t lock_counts[WAKE_LOCK_COUNT];
+static uint16_t total_count = 0;
+static wake_lock_stats_t lock_stats[WAKE_LOCK_COUNT];
+
+// Held time of every lock over all wake cycles since power on, to see what the battery is spent on
+RTC_DATA_ATTR static int64_t lifetime_held_us[WAKE_LOCK_COUNT];
+
+static SemaphoreHandle_t wake_lock_mutex = NULL;
+static EventGroupHandle_t wake_lock_events = NULL;
+
+/**********************************
+ * @brief Has to run before any task that takes a lock is started
+ *********************************/
+void wake_lock_init()
+{
+    wake_lock_mutex = xSemaphoreCreateMutex();
+    wake_lock_events = xEventGroupCreate();
+    if(wake_lock_mutex == NULL || wake_lock_events == NULL)
+    {
+        ESP_LOGE(TAG, "Error creating wake lock mutex or event group");
+        return;
+    }
+    xEventGroupSetBits(wake_lock_events, WAKE_LOCKS_RELEASED_BIT);
+}
+
+/**********************************
+ * @brief Keeps the device awake until the lock is released
+ *********************************/
+void wake_lock_acquire(wake_lock_id_t lock)
+{
+    if(lock >= WAKE_LOCK_COUNT)
+    {
+        return;
+    }
+
+    xSemaphoreTake(wake_lock_mutex, portMAX_DELAY);
+    if(lock_counts[lock]++ == 0)
+    {
+        lock_stats[lock].acquire_count++;
+        lock_stats[lock].held_since_us = esp_timer_get_time();
+    }
+    if(total_count++ == 0)
+    {
+        xEventGroupClearBits(wake_lock_events, WAKE_LOCKS_RELEASED_BIT);
+    }
+    xSemaphoreGive(wake_lock_mutex);
+}
+
+/**********************************
+ * @brief Gives up one hold of the lock. When the last hold of the last lock goes, the deep sleep task is woken
+ *********************************/
+void wake_lock_release(wake_lock_id_t lock)
+{
+    if(lock >= WAKE_LOCK_COUNT)
+    {
+        return;
+    }
+
+    xSemaphoreTake(wake_lock_mutex, portMAX_DELAY);
+    if(lock_counts[lock] == 0)
+    {
+        xSemaphoreGive(wake_lock_mutex);
+        ESP_LOGE(TAG, "Released %s wake lock that was not held", wake_lock_names[lock]);
+        return;
+    }
+
+    if(--lock_counts[lock] == 0)
+    {
+        int64_t held_us = esp_timer_get_time() - lock_stats[lock].held_since_us;
+        lock_stats[lock].held_us += held_us;
+        lock_stats[lock].held_since_us = 0;
+        lifetime_held_us[lock] += held_us;
+    }
+    if(--total_count == 0)
+    {
+        xEventGroupSetBits(wake_lock_events, WAKE_LOCKS_RELEASED_BIT);
+    }
+    xSemaphoreGive(wake_lock_mutex);
+}
+
+/**********************************
+ * @brief Blocks until no lock is held
+ * @returns false if the timeout ran out first
+ *********************************/
+bool wait_for_wake_locks_released(TickType_t timeout)
+{
+    EventBits_t bits = xEventGroupWaitBits(wake_lock_events, WAKE_LOCKS_RELEASED_BIT, pdFALSE, pdTRUE, timeout);
+    return (bits & WAKE_LOCKS_RELEASED_BIT) != 0;
+}
+
+bool are_wake_locks_released()
+{
+    return (xEventGroupGetBits(wake_lock_events) & WAKE_LOCKS_RELEASED_BIT) != 0;
+}
+
+bool is_wake_lock_held(wake_lock_id_t lock)
+{
+    return lock < WAKE_LOCK_COUNT && lock_counts[lock] > 0;
+}
+
+/**********************************
+ * @brief Gets the hold statistics of one lock for this wake cycle
+ * @returns false if the lock does not exist
+ *********************************/
+bool wake_lock_get_stats(wake_lock_id_t lock, wake_lock_stats_t *stats)
+{
+    if(lock >= WAKE_LOCK_COUNT || stats == NULL)
+    {
+        return false;
+    }
+
+    xSemaphoreTake(wake_lock_mutex, portMAX_DELAY);
+    *stats = lock_stats[lock];
+    xSemaphoreGive(wake_lock_mutex);
+    return true;
+}
+
+/**********************************
+ * @brief Logs how long each lock kept the device awake this wake cycle and since power on. Called right before
+ *        deep sleep, so the last line of each wake shows what it was spent on
+ *********************************/
+void wake_lock_log_report()
+{
+    int64_t now = esp_timer_get_time();
+
+    xSemaphoreTake(wake_lock_mutex, portMAX_DELAY);
+    for(uint8_t i = 0; i < WAKE_LOCK_COUNT; i++)
+    {
+        int64_t held_us = lock_stats[i].held_us;
+        if(lock_stats[i].held_since_us != 0)  // Still held, count it up to now
+        {
+            held_us += now - lock_stats[i].held_since_us;
+        }
+        if(lock_stats[i].acquire_count == 0 && lifetime_held_us[i] == 0)
+        {
+            continue;
+        }
+        ESP_LOGI(TAG, "%-13s held %5lu ms in %lu holds this wake, %lu s since power on", wake_lock_names[i],
+                 (unsigned long)(held_us / 1000), (unsigned long)lock_stats[i].acquire_count,
+                 (unsigned long)(lifetime_held_us[i] / 1000000));
+    }
+    ESP_LOGI(TAG, "Awake for %lu ms", (unsigned long)(now / 1000));
+    xSemaphoreGive(wake_lock_mutex);
+}
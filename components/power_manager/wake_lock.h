@@ -0,0 +1,40 @@
+#ifndef WAKE_LOCK_H
+#define WAKE_LOCK_H
+
+#include "stdint.h"
+#include "stdbool.h"
+#include "freertos/FreeRTOS.h"
+
+/************************************
+ * Everything that can keep the device out of deep sleep. Each lock is reference counted, so the same lock can be
+ * held more than once and is only free after the same number of releases
+ ***********************************/
+typedef enum {
+    WAKE_LOCK_TEMP_HUMIDITY = 0,    // Temperature and humidity measurement in progress
+    WAKE_LOCK_CO2,                  // CO2 measurement in progress
+    WAKE_LOCK_VOC,                  // VOC measurement in progress
+    WAKE_LOCK_USER_INTERACTION,     // Powered on, woken by the user or a button pressed in the last two minutes
+    WAKE_LOCK_BUZZER,               // A one-shot buzzer pattern is playing out
+    WAKE_LOCK_DISPLAY,              // A frame is being sent to the display
+    WAKE_LOCK_COUNT
+} wake_lock_id_t;
+
+/************************************
+ * How long one lock has kept the device awake
+ ***********************************/
+typedef struct {
+    uint32_t acquire_count;     // Times the lock went from free to held
+    int64_t  held_us;           // Total held time, not counting a hold that is still going
+    int64_t  held_since_us;     // When the current hold started, 0 if free
+} wake_lock_stats_t;
+
+void wake_lock_init();
+void wake_lock_acquire(wake_lock_id_t lock);
+void wake_lock_release(wake_lock_id_t lock);
+bool wait_for_wake_locks_released(TickType_t timeout);
+bool are_wake_locks_released();
+bool is_wake_lock_held(wake_lock_id_t lock);
+bool wake_lock_get_stats(wake_lock_id_t lock, wake_lock_stats_t *stats);
+void wake_lock_log_report();
+
+#endif  // WAKE_LOCK_H
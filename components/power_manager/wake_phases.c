@@ -0,0 +1,153 @@
+#include "wake_phases.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "stdio.h"
+
+static const char *TAG = "WAKE_PHASES";
+
+static const char *wake_phase_names[WAKE_PHASE_COUNT] = {
+    [WAKE_PHASE_BOOT]        = "boot",
+    [WAKE_PHASE_SENSOR_WAIT] = "sensor wait",
+    [WAKE_PHASE_I2C]         = "i2c",
+    [WAKE_PHASE_RENDER]      = "render",
+    [WAKE_PHASE_NETWORK]     = "network",
+    [WAKE_PHASE_SLEEP_ENTRY] = "sleep entry",
+    [WAKE_PHASE_AWAKE]       = "awake",
+};
+
+// This cycle's time in each phase, folded into the histograms when the cycle ends
+static int64_t cycle_phase_us[WAKE_PHASE_COUNT];
+static int64_t cycle_start_us = 0;  // A cycle starts at reset, or when a light sleep ends
+static portMUX_TYPE wake_phase_lock = portMUX_INITIALIZER_UNLOCKED;
+
+RTC_DATA_ATTR static wake_phase_stats_t phase_stats[WAKE_PHASE_COUNT];
+RTC_DATA_ATTR static uint32_t cycle_count = 0;
+
+/**********************************
+ * @brief Starts timing a phase
+ * @returns the start time to hand to wake_phase_end
+ *********************************/
+int64_t wake_phase_begin()
+{
+    return esp_timer_get_time();
+}
+
+void wake_phase_end(wake_phase_t phase, int64_t start_us)
+{
+    wake_phase_add(phase, esp_timer_get_time() - start_us);
+}
+
+/**********************************
+ * @brief Adds time to a phase of this cycle. Can be called from any task
+ *********************************/
+void wake_phase_add(wake_phase_t phase, int64_t duration_us)
+{
+    if(phase >= WAKE_PHASE_COUNT || duration_us < 0)
+    {
+        return;
+    }
+
+    taskENTER_CRITICAL(&wake_phase_lock);
+    cycle_phase_us[phase] += duration_us;
+    taskEXIT_CRITICAL(&wake_phase_lock);
+}
+
+/**********************************
+ * @brief Blocks for a sensor conversion and counts it as sensor wait
+ *********************************/
+void wake_phase_sensor_wait(uint32_t ms)
+{
+    int64_t start_us = wake_phase_begin();
+    vTaskDelay(pdMS_TO_TICKS(ms));
+    wake_phase_end(WAKE_PHASE_SENSOR_WAIT, start_us);
+}
+
+/**********************************
+ * @brief Starts a new cycle after a light sleep. A cycle after deep sleep starts at reset on its own
+ *********************************/
+void wake_phase_start_cycle()
+{
+    cycle_start_us = esp_timer_get_time();
+}
+
+static uint8_t get_histogram_bucket(uint32_t ms)
+{
+    uint8_t bucket = 0;
+    while(ms > 0 && bucket < WAKE_PHASE_HISTOGRAM_BUCKETS - 1)
+    {
+        ms >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+/**********************************
+ * @brief Called right before the device sleeps. Adds this cycle's phase totals to the histograms, logs them, and
+ *        logs the histograms every WAKE_PHASE_REPORT_CYCLES cycles
+ *********************************/
+void wake_phase_end_cycle()
+{
+    int64_t now = esp_timer_get_time();
+    uint32_t cycle_ms[WAKE_PHASE_COUNT];
+
+    taskENTER_CRITICAL(&wake_phase_lock);
+    cycle_phase_us[WAKE_PHASE_AWAKE] = now - cycle_start_us;
+    for(uint8_t i = 0; i < WAKE_PHASE_COUNT; i++)
+    {
+        cycle_ms[i] = cycle_phase_us[i] / 1000;
+        cycle_phase_us[i] = 0;
+    }
+    taskEXIT_CRITICAL(&wake_phase_lock);
+
+    for(uint8_t i = 0; i < WAKE_PHASE_COUNT; i++)
+    {
+        uint16_t *count = &phase_stats[i].histogram[get_histogram_bucket(cycle_ms[i])];
+        if(*count < UINT16_MAX)
+        {
+            (*count)++;
+        }
+        phase_stats[i].total_ms += cycle_ms[i];
+    }
+    cycle_count++;
+
+    ESP_LOGI(TAG, "Cycle %lu: boot %lu, sensor wait %lu, i2c %lu, render %lu, network %lu, sleep entry %lu, awake %lu ms",
+             (unsigned long)cycle_count, (unsigned long)cycle_ms[WAKE_PHASE_BOOT],
+             (unsigned long)cycle_ms[WAKE_PHASE_SENSOR_WAIT], (unsigned long)cycle_ms[WAKE_PHASE_I2C],
+             (unsigned long)cycle_ms[WAKE_PHASE_RENDER], (unsigned long)cycle_ms[WAKE_PHASE_NETWORK],
+             (unsigned long)cycle_ms[WAKE_PHASE_SLEEP_ENTRY], (unsigned long)cycle_ms[WAKE_PHASE_AWAKE]);
+
+    if(cycle_count % WAKE_PHASE_REPORT_CYCLES == 0)
+    {
+        wake_phase_log_report();
+    }
+    cycle_start_us = now;
+}
+
+/**********************************
+ * @brief Logs each phase's average per cycle and its histogram since power on, one count per bucket from under 1 ms
+ *        up to the last bucket
+ *********************************/
+void wake_phase_log_report()
+{
+    char line[WAKE_PHASE_HISTOGRAM_BUCKETS * 6 + 1];
+
+    if(cycle_count == 0)
+    {
+        return;
+    }
+
+    ESP_LOGI(TAG, "%lu cycles since power on, buckets are <1, <2, <4 ... ms", (unsigned long)cycle_count);
+    for(uint8_t i = 0; i < WAKE_PHASE_COUNT; i++)
+    {
+        size_t length = 0;
+        for(uint8_t bucket = 0; bucket < WAKE_PHASE_HISTOGRAM_BUCKETS; bucket++)
+        {
+            length += snprintf(&line[length], sizeof(line) - length, " %u", phase_stats[i].histogram[bucket]);
+        }
+        ESP_LOGI(TAG, "%-11s avg %5lu ms |%s", wake_phase_names[i],
+                 (unsigned long)(phase_stats[i].total_ms / cycle_count), line);
+    }
+}
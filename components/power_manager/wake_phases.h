@@ -0,0 +1,42 @@
+#ifndef WAKE_PHASES_H
+#define WAKE_PHASES_H
+
+#include "stdint.h"
+
+// Histogram bucket 0 is under 1 ms, bucket n is [2^(n-1), 2^n) ms, the last bucket takes everything longer
+#define WAKE_PHASE_HISTOGRAM_BUCKETS  16
+// Wake cycles between histogram reports in the log
+#define WAKE_PHASE_REPORT_CYCLES      20
+
+/************************************
+ * What a wake spends its time on. Phases in different tasks run at the same time, so they can add up to more than
+ * the awake time
+ ***********************************/
+typedef enum {
+    WAKE_PHASE_BOOT = 0,        // Reset to every task started
+    WAKE_PHASE_SENSOR_WAIT,     // Waiting on sensor conversions
+    WAKE_PHASE_I2C,             // Sensor I2C transfers
+    WAKE_PHASE_RENDER,          // Drawing a frame on the display
+    WAKE_PHASE_NETWORK,         // Wi-Fi and web server
+    WAKE_PHASE_SLEEP_ENTRY,     // Last wake lock released to the start of sleep
+    WAKE_PHASE_AWAKE,           // The whole wake cycle, filled in by wake_phase_end_cycle
+    WAKE_PHASE_COUNT
+} wake_phase_t;
+
+/************************************
+ * Per-cycle totals of one phase over all wake cycles since power on, kept in RTC memory
+ ***********************************/
+typedef struct {
+    uint16_t histogram[WAKE_PHASE_HISTOGRAM_BUCKETS];   // Cycles by the phase's total time in them
+    uint64_t total_ms;
+} wake_phase_stats_t;
+
+int64_t wake_phase_begin();
+void wake_phase_end(wake_phase_t phase, int64_t start_us);
+void wake_phase_add(wake_phase_t phase, int64_t duration_us);
+void wake_phase_sensor_wait(uint32_t ms);
+void wake_phase_start_cycle();
+void wake_phase_end_cycle();
+void wake_phase_log_report();
+
+#endif  // WAKE_PHASES_H
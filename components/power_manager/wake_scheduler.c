@@ -0,0 +1,147 @@
+#include "wake_scheduler.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "sys/time.h"
+
+static const char *TAG = "WAKE_SCHED";
+
+/************************************
+ * Job cadences. Temperature and VOC share a period so they land on the same wakes. While the user is interacting the
+ * jobs run about as often as they did when every sensor measured on every wake
+ ***********************************/
+static const wake_job_config_t wake_job_config[WAKE_JOB_COUNT] = {
+    [WAKE_JOB_TEMP_HUMIDITY] = {
+        .period_ms = 30000,
+        .interactive_period_ms = 5000
+    },
+    [WAKE_JOB_CO2] = {
+        .period_ms = 120000,
+        .interactive_period_ms = 10000
+    },
+    [WAKE_JOB_VOC] = {
+        .period_ms = 30000,
+        .interactive_period_ms = 1000
+    },
+};
+
+// When each job last ran, on the system clock which keeps counting through deep sleep. A job that has never run since
+// power on is due right away
+RTC_DATA_ATTR static int64_t job_last_run_ms[WAKE_JOB_COUNT];
+RTC_DATA_ATTR static uint8_t job_has_run_mask = 0;
+// Set once the first CO2 average is in after power on. Until then every job runs on its interactive period, so the
+// startup screen does not wait out ten slow CO2 readings
+RTC_DATA_ATTR static bool warm_up_done = false;
+
+static int64_t get_persistent_time_ms()
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (int64_t)now.tv_sec * 1000 + now.tv_usec / 1000;
+}
+
+static bool use_interactive_periods()
+{
+    return !warm_up_done || is_wake_lock_held(WAKE_LOCK_USER_INTERACTION);
+}
+
+/**********************************
+ * @brief Gets how long until a job is due, negative if it is overdue
+ * @param interactive picks the interactive period instead of the normal one
+ *********************************/
+static int64_t get_ms_until_due(wake_job_t job, bool interactive)
+{
+    if(!(job_has_run_mask & (1 << job)))
+    {
+        return 0;
+    }
+    uint32_t period_ms = interactive ? wake_job_config[job].interactive_period_ms : wake_job_config[job].period_ms;
+    return job_last_run_ms[job] + period_ms - get_persistent_time_ms();
+}
+
+/**********************************
+ * @brief A job is due once its period has passed, or is about to within the batch window
+ *********************************/
+bool wake_scheduler_is_due(wake_job_t job)
+{
+    if(job >= WAKE_JOB_COUNT)
+    {
+        return false;
+    }
+    return get_ms_until_due(job, use_interactive_periods()) <= WAKE_SCHEDULER_BATCH_MS;
+}
+
+/**********************************
+ * @brief Called by a job once it has done its work, starting its next period
+ *********************************/
+void wake_scheduler_job_done(wake_job_t job)
+{
+    if(job >= WAKE_JOB_COUNT)
+    {
+        return;
+    }
+    job_last_run_ms[job] = get_persistent_time_ms();
+    job_has_run_mask |= (1 << job);
+}
+
+/**********************************
+ * @brief Blocks the calling task until its job is due, with the job's wake lock given up while it waits, so the device
+ *        can sleep instead. Returns with the lock held. The wait is broken into interactive periods so a button press
+ *        partway through a long wait switches the job to its interactive cadence
+ *********************************/
+void wake_scheduler_wait_until_due(wake_job_t job, wake_lock_id_t lock)
+{
+    while(!wake_scheduler_is_due(job))
+    {
+        int64_t wait_ms = get_ms_until_due(job, use_interactive_periods());
+        if(wait_ms > wake_job_config[job].interactive_period_ms)
+        {
+            wait_ms = wake_job_config[job].interactive_period_ms;
+        }
+
+        wake_lock_release(lock);
+        vTaskDelay(pdMS_TO_TICKS(wait_ms));
+        wake_lock_acquire(lock);
+    }
+}
+
+/**********************************
+ * @brief Called once the first CO2 average after power on is in, moving the jobs from their interactive periods to the
+ *        normal ones when the user is not interacting
+ *********************************/
+void wake_scheduler_end_warm_up()
+{
+    if(!warm_up_done)
+    {
+        ESP_LOGI(TAG, "First CO2 average ready, jobs back on their normal periods");
+        warm_up_done = true;
+    }
+}
+
+/**********************************
+ * @brief Gets how long the device can deep sleep before the earliest job is due. Still warming up after power on, the
+ *        jobs stay on their interactive periods through the sleep
+ *********************************/
+uint64_t wake_scheduler_get_sleep_time_us()
+{
+    int64_t sleep_ms = INT64_MAX;
+    wake_job_t next_job = WAKE_JOB_TEMP_HUMIDITY;
+
+    for(uint8_t job = 0; job < WAKE_JOB_COUNT; job++)
+    {
+        int64_t until_due_ms = get_ms_until_due(job, !warm_up_done);
+        if(until_due_ms < sleep_ms)
+        {
+            sleep_ms = until_due_ms;
+            next_job = job;
+        }
+    }
+
+    if(sleep_ms < WAKE_SCHEDULER_MIN_SLEEP_MS)
+    {
+        sleep_ms = WAKE_SCHEDULER_MIN_SLEEP_MS;
+    }
+    ESP_LOGI(TAG, "Next wake in %lu ms for job %d", (unsigned long)sleep_ms, next_job);
+    return (uint64_t)sleep_ms * 1000;
+}
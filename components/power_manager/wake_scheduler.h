@@ -0,0 +1,38 @@
+#ifndef WAKE_SCHEDULER_H
+#define WAKE_SCHEDULER_H
+
+#include "stdint.h"
+#include "stdbool.h"
+#include "wake_lock.h"
+
+// Jobs due within this long of each other run on the same wake instead of waking the device twice
+#define WAKE_SCHEDULER_BATCH_MS   2000
+// Shortest deep sleep, so a job that is already overdue does not make the device spin through wake cycles
+#define WAKE_SCHEDULER_MIN_SLEEP_MS  1000
+
+/************************************
+ * Periodic work that wakes the device. Each job has its own cadence
+ ***********************************/
+typedef enum {
+    WAKE_JOB_TEMP_HUMIDITY = 0,
+    WAKE_JOB_CO2,
+    WAKE_JOB_VOC,
+    WAKE_JOB_COUNT
+} wake_job_t;
+
+/************************************
+ * How often a job runs. While the user is interacting with the device it runs at the shorter interactive period
+ * so the screen stays current
+ ***********************************/
+typedef struct {
+    uint32_t period_ms;
+    uint32_t interactive_period_ms;
+} wake_job_config_t;
+
+bool wake_scheduler_is_due(wake_job_t job);
+void wake_scheduler_job_done(wake_job_t job);
+void wake_scheduler_end_warm_up();
+void wake_scheduler_wait_until_due(wake_job_t job, wake_lock_id_t lock);
+uint64_t wake_scheduler_get_sleep_time_us();
+
+#endif  // WAKE_SCHEDULER_H
@@ -0,0 +1,253 @@
+#include "alarm_rules.h"
+#include "general_sensors.h"
+#include "power_button.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+
+static const char *TAG = "ALARMS";
+
+/************************************
+ * The alarm rules. Adding an alarm for another metric is one more entry here. The user rules wait a minute so a
+ * breath near the sensor does not set them off, the safety rules trip on the first unsafe reading so they react
+ * within one measurement period
+ ***********************************/
+static const alarm_rule_t alarm_rules[] = {
+    {
+        .metric = SENSOR_METRIC_CO2,
+        .source = ALARM_SOURCE_AVERAGE,
+        .threshold = &sensor_data_buffer.co2_user_threshold,
+        .hysteresis = 50,
+        .min_duration_s = 60,
+        .action = ALARM_ACTION_USER_BUZZER
+    },
+    {
+        .metric = SENSOR_METRIC_VOC,
+        .source = ALARM_SOURCE_AVERAGE,
+        .threshold = &sensor_data_buffer.voc_user_threshold,
+        .hysteresis = 20,
+        .min_duration_s = 60,
+        .action = ALARM_ACTION_USER_BUZZER
+    },
+    {
+        .metric = SENSOR_METRIC_CO2,
+        .source = ALARM_SOURCE_READING,
+        .threshold = &sensor_data_buffer.co2_generally_unsafe_value,
+        .hysteresis = 100,
+        .min_duration_s = 0,
+        .action = ALARM_ACTION_SAFETY_BUZZER
+    },
+    {
+        .metric = SENSOR_METRIC_VOC,
+        .source = ALARM_SOURCE_READING,
+        .threshold = &sensor_data_buffer.voc_generally_unsafe_value,
+        .hysteresis = 40,
+        .min_duration_s = 0,
+        .action = ALARM_ACTION_SAFETY_BUZZER
+    },
+};
+#define ALARM_RULE_COUNT  (sizeof(alarm_rules) / sizeof(alarm_rules[0]))
+
+/************************************
+ * How each action is driven and acknowledged
+ ***********************************/
+typedef struct {
+    void (*set_output)(bool on);
+    bool (*is_acked)();
+    void (*reset_ack)();
+} alarm_action_config_t;
+
+static const alarm_action_config_t alarm_actions[ALARM_ACTION_COUNT] = {
+    [ALARM_ACTION_USER_BUZZER] = {
+        .set_output = set_user_buzzer,
+        .is_acked = has_user_buzzer_been_acked,
+        .reset_ack = reset_user_buzzer_ack
+    },
+    [ALARM_ACTION_SAFETY_BUZZER] = {
+        .set_output = set_safety_buzzer,
+        .is_acked = has_safety_buzzer_been_acked,
+        .reset_ack = reset_safety_buzzer_ack
+    },
+};
+
+RTC_DATA_ATTR static alarm_rule_state_t rule_state[ALARM_RULE_COUNT];
+
+// The inputs of the last evaluation. Rules whose inputs have not changed are skipped. None of this is kept over deep
+// sleep, so the first evaluation after a wake looks at everything and sets the buzzers, which are off after a reset
+static uint16_t last_value[ALARM_RULE_COUNT];
+static uint16_t last_threshold[ALARM_RULE_COUNT];
+static bool last_acked[ALARM_ACTION_COUNT];
+static bool action_output_on[ALARM_ACTION_COUNT];
+static bool snapshot_valid = false;
+
+/**********************************
+ * @brief Gets the value a rule compares against its threshold
+ *********************************/
+static uint16_t get_rule_value(const alarm_rule_t *rule)
+{
+    if(rule->metric >= SENSOR_METRIC_COUNT)
+    {
+        return 0;
+    }
+    if(rule->source == ALARM_SOURCE_READING)
+    {
+        return sensor_data_buffer.latest_reading[rule->metric];
+    }
+
+    switch(rule->metric)
+    {
+        case SENSOR_METRIC_TEMPERATURE:
+            return sensor_data_buffer.average_temp;
+        case SENSOR_METRIC_HUMIDITY:
+            return sensor_data_buffer.average_humidity;
+        case SENSOR_METRIC_CO2:
+            return sensor_data_buffer.average_co2;
+        case SENSOR_METRIC_VOC:
+            return sensor_data_buffer.average_voc;
+        default:
+            return 0;
+    }
+}
+
+/**********************************
+ * @brief Moves one rule along: it trips after staying above the threshold for the minimum duration, and clears once
+ *        the value is the hysteresis band below the threshold
+ * @returns true if the rule tripped or cleared
+ *********************************/
+static bool evaluate_rule(const alarm_rule_t *rule, alarm_rule_state_t *state, uint16_t value, uint32_t now_s)
+{
+    uint16_t threshold = *rule->threshold;
+
+    if(state->tripped)
+    {
+        if((int32_t)value <= (int32_t)threshold - rule->hysteresis)
+        {
+            state->tripped = false;
+            state->above_since_s = 0;
+            return true;
+        }
+        return false;
+    }
+
+    if(value <= threshold)
+    {
+        state->above_since_s = 0;
+        return false;
+    }
+
+    if(state->above_since_s == 0)
+    {
+        state->above_since_s = now_s;
+    }
+    if(now_s - state->above_since_s >= rule->min_duration_s)
+    {
+        state->tripped = true;
+        return true;
+    }
+    return false;
+}
+
+/**********************************
+ * @brief Checks whether any of an action's rules is tripped
+ *********************************/
+bool is_alarm_action_tripped(alarm_action_t action)
+{
+    for(uint8_t i = 0; i < ALARM_RULE_COUNT; i++)
+    {
+        if(alarm_rules[i].action == action && rule_state[i].tripped)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**********************************
+ * @brief Gets how long until the first rule waiting out its minimum duration would trip, so the caller can evaluate
+ *        again then instead of waiting for the next reading
+ * @returns the wait in ms, 0 if one is already due, UINT32_MAX if no rule is waiting
+ *********************************/
+uint32_t get_ms_until_alarm_pending_due()
+{
+    uint32_t now_s = get_persistent_time_seconds();
+    uint32_t wait_ms = UINT32_MAX;
+
+    for(uint8_t i = 0; i < ALARM_RULE_COUNT; i++)
+    {
+        const alarm_rule_state_t *state = &rule_state[i];
+        if(state->tripped || state->above_since_s == 0)
+        {
+            continue;
+        }
+
+        uint32_t elapsed_s = now_s - state->above_since_s;
+        uint32_t rule_wait_ms = 0;
+        if(elapsed_s < alarm_rules[i].min_duration_s)
+        {
+            rule_wait_ms = (alarm_rules[i].min_duration_s - elapsed_s) * 1000;
+        }
+        if(rule_wait_ms < wait_ms)
+        {
+            wait_ms = rule_wait_ms;
+        }
+    }
+    return wait_ms;
+}
+
+/**********************************
+ * @brief Evaluates the rules whose value, threshold or acknowledgement changed since the last call, plus any
+ *        rule that is waiting out its minimum duration. An action is on while one of its rules is tripped and it has
+ *        not been acknowledged, and its ack is cleared once none of its rules are tripped. Outputs are only written
+ *        when they change
+ *********************************/
+void alarm_rules_evaluate()
+{
+    bool action_inputs_changed[ALARM_ACTION_COUNT] = {false};
+    uint32_t now_s = get_persistent_time_seconds();
+
+    for(uint8_t i = 0; i < ALARM_RULE_COUNT; i++)
+    {
+        const alarm_rule_t *rule = &alarm_rules[i];
+        alarm_rule_state_t *state = &rule_state[i];
+        uint16_t value = get_rule_value(rule);
+        bool pending = !state->tripped && state->above_since_s != 0;
+
+        if(snapshot_valid && !pending && value == last_value[i] && *rule->threshold == last_threshold[i])
+        {
+            continue;
+        }
+        last_value[i] = value;
+        last_threshold[i] = *rule->threshold;
+        if(evaluate_rule(rule, state, value, now_s))
+        {
+            ESP_LOGI(TAG, "Rule %d %s at %d", i, state->tripped ? "tripped" : "cleared", value);
+            action_inputs_changed[rule->action] = true;
+        }
+    }
+
+    for(uint8_t action = 0; action < ALARM_ACTION_COUNT; action++)
+    {
+        const alarm_action_config_t *config = &alarm_actions[action];
+        bool acked = config->is_acked();
+
+        if(snapshot_valid && !action_inputs_changed[action] && acked == last_acked[action])
+        {
+            continue;
+        }
+
+        bool tripped = is_alarm_action_tripped(action);
+        if(!tripped && acked)  // Back below the threshold, the next trip should not already be acknowledged
+        {
+            config->reset_ack();
+            acked = false;
+        }
+        last_acked[action] = acked;
+
+        bool output_on = tripped && !acked;
+        if(!snapshot_valid || output_on != action_output_on[action])
+        {
+            config->set_output(output_on);
+            action_output_on[action] = output_on;
+        }
+    }
+    snapshot_valid = true;
+}
@@ -0,0 +1,51 @@
+#ifndef ALARM_RULES_H
+#define ALARM_RULES_H
+
+#include "stdint.h"
+#include "stdbool.h"
+#include "general_sensors.h"
+
+/************************************
+ * What a tripped rule drives. An action stays on while any of its rules is tripped, until the user acknowledges it
+ ***********************************/
+typedef enum {
+    ALARM_ACTION_USER_BUZZER = 0,
+    ALARM_ACTION_SAFETY_BUZZER,
+    ALARM_ACTION_COUNT
+} alarm_action_t;
+
+/************************************
+ * What a rule compares against its threshold. The averages only come every 10 readings, which at the slower
+ * cadences is many minutes, so rules that have to react quickly use each reading instead
+ ***********************************/
+typedef enum {
+    ALARM_SOURCE_AVERAGE = 0,   // The latest 10-reading average
+    ALARM_SOURCE_READING,       // The latest accepted reading
+} alarm_source_t;
+
+/************************************
+ * One alarm rule. A rule trips once its metric has stayed above the threshold for the minimum duration, and clears
+ * once it drops the hysteresis band below the threshold
+ ***********************************/
+typedef struct {
+    sensor_metric_t  metric;
+    alarm_source_t   source;
+    const uint16_t  *threshold;         // Read on every evaluation so user-set thresholds take effect right away
+    uint16_t         hysteresis;        // In the metric's units
+    uint32_t         min_duration_s;    // 0 trips on the first value above the threshold
+    alarm_action_t   action;
+} alarm_rule_t;
+
+/************************************
+ * Evaluation state for one rule, kept in RTC memory so a time above threshold carries over deep sleep
+ ***********************************/
+typedef struct {
+    bool     tripped;
+    uint32_t above_since_s;     // Persistent time the average first went above the threshold, 0 if it is not above
+} alarm_rule_state_t;
+
+void alarm_rules_evaluate();
+bool is_alarm_action_tripped(alarm_action_t action);
+uint32_t get_ms_until_alarm_pending_due();
+
+#endif  // ALARM_RULES_H
@@ -8,6 +8,10 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
 #include "freertos/queue.h"
+#include "wake_lock.h"
+#include "wake_scheduler.h"
+#include "boot_timeline.h"
+#include "wake_phases.h"
 
 #define CO2_SENS_ADDR_A    0x62     //0x29
 #define CO2_SENS_ADDR_B    0x2A
@@ -52,11 +56,7 @@ esp_err_t co2_read_data(uint16_t *co2_concentration)
         }
         else   // if the crc check was succesful, add the newest read value to the data array
         {
-            if(sensor_data_buffer.co2_reading_index < MAX_SENSOR_READINGS)
-            {
-                sensor_data_buffer.co2_concentration[sensor_data_buffer.co2_reading_index] = *co2_concentration;
-                sensor_data_buffer.co2_reading_index++;
-            }
+            store_sensor_reading(SENSOR_METRIC_CO2, *co2_concentration);
         } 
 
         // have sensor stop taking measurements after a read to save power
@@ -91,33 +91,40 @@ void co2_task(void *parameter)
         esp_err_t err = ESP_FAIL;
         uint16_t co2_concentration = 0;
 
+        // Only measure when the scheduler says a CO2 reading is due, the device can sleep through the wait. main takes
+        // the wake lock before the task starts, so it is held here
+        wake_scheduler_wait_until_due(WAKE_JOB_CO2, WAKE_LOCK_CO2);
+
         if(xSemaphoreTake(co2_mutex, pdMS_TO_TICKS(200)) == pdTRUE) // Ensure that nothing else interacts with the CO2 data while taking a measurement
         {
-            // Give other sensor tasks the chance to take their mutex as well, ensures it only goes into deep sleep when needed, and for sensor to wakeup
-            // and time for the CO2 sensor to be ready to receive command
-            vTaskDelay(pdMS_TO_TICKS(500));
+            // Give the CO2 sensor time to be ready to receive a command
+            wake_phase_sensor_wait(500);
 
             // Wakeup CO2 sensor every time the device itsel awakens, this sensor does not respond to this command, but it is necessary
             // This is the cause of the red log when monitoring on computer
+            boot_timeline_mark(BOOT_EVENT_FIRST_I2C_COMMAND);
+            int64_t i2c_start_us = wake_phase_begin();
             i2c_master_transmit(i2c_co2_device_handle, wakeup_co2_cmd, sizeof(wakeup_co2_cmd), pdMS_TO_TICKS(300));
 
             err = i2c_master_transmit(i2c_co2_device_handle, co2_start_cmd, sizeof(co2_start_cmd), pdMS_TO_TICKS(300));
+            wake_phase_end(WAKE_PHASE_I2C, i2c_start_us);
             if(err != ESP_OK)
             {
                 ESP_LOGE(TAG, "Error writing measure command to sensor with error: %s", esp_err_to_name(err));
             }
 
             // after sensors receive initial command, give time to take measurement
-            vTaskDelay(pdMS_TO_TICKS(5000));
+            wake_phase_sensor_wait(5000);
                     
+            i2c_start_us = wake_phase_begin();
             if(co2_read_data(&co2_concentration) == ESP_OK)
             {
                 ESP_LOGI("CO2 Reading", "PPM: %d", co2_concentration);
             }
             
-            // Release the semaphore, power down sensor, and delay so that the deep sleep task has time to check that the semaphore was released
-            vTaskDelay(pdMS_TO_TICKS(50));
+            // Power down the sensor before giving up the wake lock
             err = i2c_master_transmit(i2c_co2_device_handle, power_down_co2_cmd, sizeof(power_down_co2_cmd), pdMS_TO_TICKS(300));
+            wake_phase_end(WAKE_PHASE_I2C, i2c_start_us);
             if(err != ESP_OK)
             {
                 ESP_LOGE(TAG, "Error powering down CO2 Sensor before Deep Sleep");
@@ -128,7 +135,7 @@ void co2_task(void *parameter)
             }
         }
         xSemaphoreGive(co2_mutex);
-        vTaskDelay(pdMS_TO_TICKS(5000));
+        wake_scheduler_job_done(WAKE_JOB_CO2);
     }
         
 }
\ No newline at end of file
@@ -0,0 +1,169 @@
+#include "co2_trend.h"
+#include "general_sensors.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_sleep.h"
+
+// Anything slower than this is noise as far as predicting a threshold crossing goes
+#define MIN_RISING_SLOPE_PPM_PER_HOUR  20
+// Predictions further out than this are not useful to the user
+#define MAX_PREDICTION_MINUTES         240
+
+RTC_DATA_ATTR static co2_trend_t co2_trend;
+static portMUX_TYPE co2_trend_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**********************************
+ * @brief Moves the x = 0 reference to a new time. Every x shifts by the same amount, so the sums can be corrected
+ *        directly without touching the stored samples
+ *********************************/
+static void shift_reference_time(co2_trend_t *trend, uint32_t new_reference)
+{
+    int64_t shift = (int64_t)new_reference - trend->reference_time;
+    int64_t n = trend->sample_count;
+
+    trend->sum_xx += -2 * shift * trend->sum_x + n * shift * shift;
+    trend->sum_xy -= shift * trend->sum_y;
+    trend->sum_x  -= n * shift;
+    trend->reference_time = new_reference;
+}
+
+/**********************************
+ * @brief Adds an accepted CO2 reading to the regression. Once the window is full the oldest reading is removed first,
+ *        so each update is a constant amount of work regardless of the window size
+ * @param co2_concentration is the filtered CO2 reading in ppm
+ *********************************/
+void co2_trend_add_sample(uint16_t co2_concentration)
+{
+    uint32_t now = get_persistent_time_seconds();
+    co2_trend_t *trend = &co2_trend;
+
+    taskENTER_CRITICAL(&co2_trend_lock);
+
+    if(trend->sample_count == 0)
+    {
+        trend->reference_time = now;
+    }
+
+    if(trend->sample_count == CO2_TREND_WINDOW)  // Remove the oldest sample, it is in the slot about to be overwritten
+    {
+        uint8_t oldest = trend->next_slot;
+        int64_t x = (int64_t)trend->sample_time[oldest] - trend->reference_time;
+        int64_t y = trend->sample_co2[oldest];
+        trend->sum_x  -= x;
+        trend->sum_xx -= x * x;
+        trend->sum_y  -= y;
+        trend->sum_xy -= x * y;
+        trend->sample_count--;
+
+        // Re-reference to the sample that is now the oldest
+        shift_reference_time(trend, trend->sample_time[(oldest + 1) % CO2_TREND_WINDOW]);
+    }
+
+    int64_t x = (int64_t)now - trend->reference_time;
+    int64_t y = co2_concentration;
+    trend->sum_x  += x;
+    trend->sum_xx += x * x;
+    trend->sum_y  += y;
+    trend->sum_xy += x * y;
+
+    trend->sample_time[trend->next_slot] = now;
+    trend->sample_co2[trend->next_slot] = co2_concentration;
+    trend->next_slot = (trend->next_slot + 1) % CO2_TREND_WINDOW;
+    trend->sample_count++;
+
+    taskEXIT_CRITICAL(&co2_trend_lock);
+}
+
+/**********************************
+ * @brief Takes a consistent copy of the regression state, and checks there is enough data spread over time to fit a line
+ *********************************/
+static bool get_trend_snapshot(co2_trend_t *snapshot, int64_t *numerator, int64_t *denominator)
+{
+    taskENTER_CRITICAL(&co2_trend_lock);
+    *snapshot = co2_trend;
+    taskEXIT_CRITICAL(&co2_trend_lock);
+
+    int64_t n = snapshot->sample_count;
+    if(n < CO2_TREND_MIN_SAMPLES)
+    {
+        return false;
+    }
+
+    *numerator   = n * snapshot->sum_xy - snapshot->sum_x * snapshot->sum_y;
+    *denominator = n * snapshot->sum_xx - snapshot->sum_x * snapshot->sum_x;
+    return *denominator > 0;  // All samples at the same time would give no slope
+}
+
+/**********************************
+ * @brief Gets the least-squares slope of CO2 over the recent window
+ * @param ppm_per_hour is used as an output parameter
+ * @returns false if there are not enough samples yet
+ *********************************/
+bool co2_trend_get_slope(int32_t *ppm_per_hour)
+{
+    co2_trend_t snapshot;
+    int64_t numerator = 0;
+    int64_t denominator = 0;
+
+    if(!get_trend_snapshot(&snapshot, &numerator, &denominator))
+    {
+        return false;
+    }
+    *ppm_per_hour = (int32_t)((numerator * 3600) / denominator);
+    return true;
+}
+
+/**********************************
+ * @brief Predicts how long until the fitted line reaches a threshold. The line is evaluated at the newest sample rather
+ *        than using the raw newest reading, so one noisy sample does not swing the prediction
+ * @param threshold is the CO2 level in ppm
+ * @returns minutes until the threshold is reached, 0 if the fit is already at or above it, or CO2_TREND_NO_PREDICTION
+ *********************************/
+int32_t co2_trend_minutes_to_threshold(uint16_t threshold)
+{
+    co2_trend_t snapshot;
+    int64_t numerator = 0;
+    int64_t denominator = 0;
+
+    if(!get_trend_snapshot(&snapshot, &numerator, &denominator))
+    {
+        return CO2_TREND_NO_PREDICTION;
+    }
+
+    int64_t n = snapshot.sample_count;
+    uint8_t newest = (snapshot.next_slot + CO2_TREND_WINDOW - 1) % CO2_TREND_WINDOW;
+    int64_t newest_x = (int64_t)snapshot.sample_time[newest] - snapshot.reference_time;
+
+    // fitted value at the newest sample, scaled by n * denominator to stay in integers
+    int64_t fitted_scaled = snapshot.sum_y * denominator + numerator * (n * newest_x - snapshot.sum_x);
+    int64_t threshold_scaled = (int64_t)threshold * n * denominator;
+    if(fitted_scaled >= threshold_scaled)
+    {
+        return 0;
+    }
+
+    if((numerator * 3600) / denominator < MIN_RISING_SLOPE_PPM_PER_HOUR)
+    {
+        return CO2_TREND_NO_PREDICTION;
+    }
+
+    // (threshold - fitted) / slope, with slope = numerator / denominator in ppm per second
+    int64_t minutes = (threshold_scaled - fitted_scaled) / (n * numerator * 60);
+    if(minutes > MAX_PREDICTION_MINUTES)
+    {
+        return CO2_TREND_NO_PREDICTION;
+    }
+    return (int32_t)minutes;
+}
+
+/**********************************
+ * @brief The two functions below give the prediction against the thresholds used by the buzzers, for the display and alarm logic
+ *********************************/
+int32_t get_co2_minutes_to_user_threshold()
+{
+    return co2_trend_minutes_to_threshold(sensor_data_buffer.co2_user_threshold);
+}
+
+int32_t get_co2_minutes_to_safety_threshold()
+{
+    return co2_trend_minutes_to_threshold(sensor_data_buffer.co2_generally_unsafe_value);
+}
@@ -0,0 +1,36 @@
+#ifndef CO2_TREND_H
+#define CO2_TREND_H
+
+#include "stdint.h"
+#include "stdbool.h"
+
+// Number of most recent CO2 samples the regression line is fitted over
+#define CO2_TREND_WINDOW         16
+// Fewer samples than this give too noisy a slope to predict anything
+#define CO2_TREND_MIN_SAMPLES    4
+// Returned when the level is not rising toward the threshold, or it would take too long to matter
+#define CO2_TREND_NO_PREDICTION  (-1)
+
+/************************************
+ * Sliding least-squares state. Sums are kept relative to the oldest sample's time so they stay small,
+ * and moving that reference when the oldest sample leaves is an O(1) correction to the sums
+ ***********************************/
+typedef struct {
+    uint32_t sample_time[CO2_TREND_WINDOW];   // Seconds, from the persistent system clock
+    uint16_t sample_co2[CO2_TREND_WINDOW];
+    uint8_t  next_slot;
+    uint8_t  sample_count;
+    uint32_t reference_time;
+    int64_t  sum_x;
+    int64_t  sum_xx;
+    int64_t  sum_y;
+    int64_t  sum_xy;
+} co2_trend_t;
+
+void co2_trend_add_sample(uint16_t co2_concentration);
+bool co2_trend_get_slope(int32_t *ppm_per_hour);
+int32_t co2_trend_minutes_to_threshold(uint16_t threshold);
+int32_t get_co2_minutes_to_user_threshold();
+int32_t get_co2_minutes_to_safety_threshold();
+
+#endif  // CO2_TREND_H
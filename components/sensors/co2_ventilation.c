@@ -0,0 +1,159 @@
+#include "co2_ventilation.h"
+#include "general_sensors.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_sleep.h"
+
+// A decay segment starts on a drop of at least this much while CO2 is well above outdoor levels
+#define DECAY_START_DROP_PPM       5
+#define DECAY_START_EXCESS_PPM     150
+// Close to the outdoor level, ln(excess) is dominated by sensor noise, so the segment ends there
+#define DECAY_MIN_EXCESS_PPM       60
+// Rises smaller than this are treated as noise rather than the end of the decay
+#define DECAY_NOISE_TOLERANCE_PPM  15
+// A segment needs this many samples spread over this long before its fit is trusted
+#define DECAY_MIN_SAMPLES          5
+#define DECAY_MIN_SECONDS          (10 * 60)
+// Long segments are restarted so the estimate follows changes like a window being opened or closed
+#define DECAY_MAX_SECONDS          (4 * 60 * 60)
+
+// ln(2) in Q16
+#define LN2_Q16  45426
+
+// log2(1 + i/16) in Q16, used to interpolate the fractional part of log2
+static const uint32_t log2_fraction_q16[17] = {
+        0,  5732, 11136, 16248, 21098, 25711, 30109, 34312, 38336,
+    42196, 45904, 49472, 52911, 56229, 59434, 62534, 65536
+};
+
+RTC_DATA_ATTR static co2_ventilation_t co2_ventilation;
+RTC_DATA_ATTR static uint32_t previous_sample_time;
+static portMUX_TYPE co2_ventilation_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**********************************
+ * @brief Natural log in Q16 fixed point. The integer part of log2 is the position of the highest set bit, the
+ *        fractional part comes from the table using the next bits of the value
+ * @param value must be at least 1
+ *********************************/
+static int32_t ln_q16(uint32_t value)
+{
+    int32_t msb = 31 - __builtin_clz(value);
+
+    // Normalize to 1.xxx with 16 fractional bits, then split into a table index and an interpolation fraction
+    uint32_t mantissa = (msb >= 16) ? (value >> (msb - 16)) : (value << (16 - msb));
+    uint32_t fraction = mantissa & 0xFFFF;
+    uint32_t index = fraction >> 12;
+    uint32_t remainder = fraction & 0x0FFF;
+
+    uint32_t log2_fraction = log2_fraction_q16[index] +
+                             (((log2_fraction_q16[index + 1] - log2_fraction_q16[index]) * remainder) >> 12);
+    int64_t log2_value = ((int64_t)msb << 16) + log2_fraction;
+    return (int32_t)((log2_value * LN2_Q16) >> 16);
+}
+
+/**********************************
+ * @brief Adds one point of the current segment to the regression sums
+ *********************************/
+static void add_decay_point(co2_ventilation_t *vent, uint32_t sample_time, uint16_t co2_concentration)
+{
+    int64_t x = (int64_t)sample_time - vent->start_time;
+    int64_t y = ln_q16(co2_concentration - CO2_OUTDOOR_PPM);
+
+    vent->sum_x  += x;
+    vent->sum_xx += x * x;
+    vent->sum_y  += y;
+    vent->sum_xy += x * y;
+    vent->sample_count++;
+}
+
+/**********************************
+ * @brief Fits the current segment and, if it is long enough and actually decaying, publishes the air change rate.
+ *        The fitted slope is -lambda in Q16 per second, and air changes per hour is lambda * 3600
+ *********************************/
+static void update_ventilation_estimate(co2_ventilation_t *vent, uint32_t now)
+{
+    if(vent->sample_count < DECAY_MIN_SAMPLES || (now - vent->start_time) < DECAY_MIN_SECONDS)
+    {
+        return;
+    }
+
+    int64_t n = vent->sample_count;
+    int64_t numerator   = n * vent->sum_xy - vent->sum_x * vent->sum_y;
+    int64_t denominator = n * vent->sum_xx - vent->sum_x * vent->sum_x;
+    if(denominator <= 0 || numerator >= 0)
+    {
+        return;
+    }
+
+    int64_t decay_per_hour_q16 = (-numerator * 3600) / denominator;
+    int64_t ach_x100 = (decay_per_hour_q16 * 100) >> 16;
+    vent->latest_ach_x100 = (ach_x100 > UINT16_MAX) ? UINT16_MAX : (uint16_t)ach_x100;
+    vent->has_estimate = true;
+}
+
+/**********************************
+ * @brief Tracks CO2 decay segments and updates the air change estimate. A segment starts on a clear drop while CO2 is
+ *        well above outdoor levels and ends when CO2 rises again, gets close to outdoor levels, or runs too long
+ * @param co2_concentration is the filtered CO2 reading in ppm
+ *********************************/
+void co2_ventilation_add_sample(uint16_t co2_concentration)
+{
+    uint32_t now = get_persistent_time_seconds();
+    int32_t excess = (int32_t)co2_concentration - CO2_OUTDOOR_PPM;
+    co2_ventilation_t *vent = &co2_ventilation;
+
+    taskENTER_CRITICAL(&co2_ventilation_lock);
+
+    if(vent->in_segment)
+    {
+        bool rising = co2_concentration > vent->previous_co2 + DECAY_NOISE_TOLERANCE_PPM;
+        bool near_outdoor = excess < DECAY_MIN_EXCESS_PPM;
+        bool too_long = (now - vent->start_time) > DECAY_MAX_SECONDS;
+
+        if(rising || near_outdoor || too_long)
+        {
+            vent->in_segment = false;
+        }
+        else
+        {
+            add_decay_point(vent, now, co2_concentration);
+            update_ventilation_estimate(vent, now);
+        }
+    }
+
+    // Start a new segment from the previous sample when CO2 clearly starts dropping
+    if(!vent->in_segment && vent->previous_co2 > 0 && excess >= DECAY_START_EXCESS_PPM &&
+       co2_concentration + DECAY_START_DROP_PPM <= vent->previous_co2)
+    {
+        vent->in_segment = true;
+        vent->start_time = previous_sample_time;
+        vent->sample_count = 0;
+        vent->sum_x = 0;
+        vent->sum_xx = 0;
+        vent->sum_y = 0;
+        vent->sum_xy = 0;
+        add_decay_point(vent, previous_sample_time, vent->previous_co2);
+        add_decay_point(vent, now, co2_concentration);
+    }
+
+    vent->previous_co2 = co2_concentration;
+    previous_sample_time = now;
+
+    taskEXIT_CRITICAL(&co2_ventilation_lock);
+}
+
+/**********************************
+ * @brief Gets the most recent ventilation rate estimate, from the current decay segment or the last one that qualified
+ * @param air_changes_per_hour_x100 is used as an output parameter
+ * @returns false if no decay segment has qualified yet
+ *********************************/
+bool get_ventilation_rate(uint16_t *air_changes_per_hour_x100)
+{
+    bool has_estimate = false;
+
+    taskENTER_CRITICAL(&co2_ventilation_lock);
+    has_estimate = co2_ventilation.has_estimate;
+    *air_changes_per_hour_x100 = co2_ventilation.latest_ach_x100;
+    taskEXIT_CRITICAL(&co2_ventilation_lock);
+
+    return has_estimate;
+}
@@ -0,0 +1,30 @@
+#ifndef CO2_VENTILATION_H
+#define CO2_VENTILATION_H
+
+#include "stdint.h"
+#include "stdbool.h"
+
+// Typical outdoor CO2 level the room decays toward once it is empty
+#define CO2_OUTDOOR_PPM  420
+
+/************************************
+ * State of the current CO2 decay segment. ln(CO2 - outdoor) against time is a straight line while the room
+ * air is being replaced, and its slope is minus the air change rate. Only running sums are kept
+ ***********************************/
+typedef struct {
+    bool     in_segment;
+    uint16_t previous_co2;
+    uint32_t start_time;          // Seconds, from the persistent system clock
+    uint16_t sample_count;        // Up to DECAY_MAX_SECONDS worth of samples, thousands at a 5 s cadence
+    int64_t  sum_x;
+    int64_t  sum_xx;
+    int64_t  sum_y;               // y is ln(excess CO2) in Q16
+    int64_t  sum_xy;
+    uint16_t latest_ach_x100;     // Most recent air changes per hour estimate, x100
+    bool     has_estimate;
+} co2_ventilation_t;
+
+void co2_ventilation_add_sample(uint16_t co2_concentration);
+bool get_ventilation_rate(uint16_t *air_changes_per_hour_x100);
+
+#endif  // CO2_VENTILATION_H
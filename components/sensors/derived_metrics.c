@@ -0,0 +1,189 @@
+#include "derived_metrics.h"
+#include "string.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_sleep.h"
+
+// Saturation vapor pressure table, Magnus formula over water, one entry every 5 C from -40 C to +85 C, in 0.1 Pa
+#define SVP_TABLE_MIN_C100   (-4000)
+#define SVP_TABLE_STEP_C100  500
+#define SVP_TABLE_LENGTH     26
+static const uint32_t svp_table_dpa[SVP_TABLE_LENGTH] = {
+       190,    316,    512,    811,   1260,   1919,   2870,   4222,   6112,   8717,
+     12260,  17017,  23326,  31601,  42337,  56128,  73675,  95797, 123452, 157742,
+    199933, 251467, 313977, 389299, 479489, 586834
+};
+
+// NWS heat index (Rothfusz regression with its low and high humidity adjustments) in 0.1 F.
+// Columns are 80 F to 110 F every 5 F, rows are 0 %rH to 100 %rH every 10 %
+#define HEAT_INDEX_MIN_F10     800
+#define HEAT_INDEX_STEP_F10    50
+#define HEAT_INDEX_COLUMNS     7
+#define HEAT_INDEX_STEP_RH100  1000
+#define HEAT_INDEX_ROWS        11
+static const int16_t heat_index_table_f10[HEAT_INDEX_ROWS][HEAT_INDEX_COLUMNS] = {
+    { 777,  803,  839,  873,  914,  953,  992},
+    { 782,  814,  853,  894,  941,  991, 1044},
+    { 786,  820,  863,  915,  975, 1043, 1120},
+    { 791,  829,  879,  944, 1023, 1116, 1223},
+    { 796,  843,  907,  990, 1093, 1215, 1357},
+    { 808,  865,  946, 1052, 1183, 1339, 1520},
+    { 818,  893,  997, 1131, 1295, 1489, 1712},
+    { 830,  927, 1059, 1226, 1428, 1664, 1935},
+    { 842,  968, 1133, 1338, 1582, 1865, 2188},
+    { 863, 1018, 1219, 1466, 1757, 2092, 2470},
+    { 893, 1076, 1316, 1611, 1953, 2344, 2782}
+};
+
+// 2.1668 g*K/J, the water vapor density constant, x10000
+#define ABS_HUMIDITY_CONSTANT_X10000  21668
+#define ZERO_C_IN_CENTI_KELVIN        27315
+
+RTC_DATA_ATTR static derived_metrics_t latest_derived_metrics;
+static portMUX_TYPE derived_metrics_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**********************************
+ * @brief Saturation vapor pressure at the given temperature, linearly interpolated from the table
+ * @param temperature_c100 is the temperature in 0.01 C, clamped to the table range
+ * @returns the saturation vapor pressure in 0.1 Pa
+ *********************************/
+static uint32_t saturation_vapor_pressure(int32_t temperature_c100)
+{
+    int32_t offset = temperature_c100 - SVP_TABLE_MIN_C100;
+    if(offset <= 0)
+    {
+        return svp_table_dpa[0];
+    }
+
+    int32_t index = offset / SVP_TABLE_STEP_C100;
+    if(index >= SVP_TABLE_LENGTH - 1)
+    {
+        return svp_table_dpa[SVP_TABLE_LENGTH - 1];
+    }
+
+    int32_t fraction = offset % SVP_TABLE_STEP_C100;
+    uint32_t span = svp_table_dpa[index + 1] - svp_table_dpa[index];
+    return svp_table_dpa[index] + (span * fraction) / SVP_TABLE_STEP_C100;
+}
+
+/**********************************
+ * @brief Dew point is the temperature whose saturation vapor pressure equals the actual vapor pressure, so it is found
+ *        by searching the same table in reverse. Using one table both ways means 100 %rH gives back the air temperature exactly
+ * @param vapor_pressure_dpa is the actual vapor pressure in 0.1 Pa
+ * @returns the dew point in 0.01 C
+ *********************************/
+static int32_t dew_point_from_vapor_pressure(uint32_t vapor_pressure_dpa)
+{
+    if(vapor_pressure_dpa <= svp_table_dpa[0])
+    {
+        return SVP_TABLE_MIN_C100;
+    }
+
+    int32_t index = 0;
+    while(index < SVP_TABLE_LENGTH - 2 && vapor_pressure_dpa >= svp_table_dpa[index + 1])
+    {
+        index++;
+    }
+
+    uint32_t span = svp_table_dpa[index + 1] - svp_table_dpa[index];
+    uint32_t above = vapor_pressure_dpa - svp_table_dpa[index];
+    if(above > span)
+    {
+        above = span;
+    }
+    return SVP_TABLE_MIN_C100 + index * SVP_TABLE_STEP_C100 + (int32_t)((above * SVP_TABLE_STEP_C100) / span);
+}
+
+/**********************************
+ * @brief NWS heat index. Below 80 F the simple Steadman formula is used, which is what the NWS does as well.
+ *        At and above 80 F the regression is bilinearly interpolated from the table, clamped at 110 F
+ * @param temperature_f10 is the temperature in 0.1 F
+ * @param humidity_c100 is the relative humidity in 0.01 %
+ * @returns the heat index in 0.1 F
+ *********************************/
+static int32_t heat_index(int32_t temperature_f10, uint32_t humidity_c100)
+{
+    if(temperature_f10 < HEAT_INDEX_MIN_F10)
+    {
+        // 0.5 * (T + 61 + (T - 68) * 1.2 + RH * 0.094)
+        return (temperature_f10 + 610 + ((temperature_f10 - 680) * 6) / 5 + (int32_t)(humidity_c100 * 94) / 10000) / 2;
+    }
+
+    int32_t t_offset = temperature_f10 - HEAT_INDEX_MIN_F10;
+    int32_t column = t_offset / HEAT_INDEX_STEP_F10;
+    int32_t t_fraction = t_offset % HEAT_INDEX_STEP_F10;
+    if(column >= HEAT_INDEX_COLUMNS - 1)
+    {
+        column = HEAT_INDEX_COLUMNS - 2;
+        t_fraction = HEAT_INDEX_STEP_F10;
+    }
+
+    int32_t row = humidity_c100 / HEAT_INDEX_STEP_RH100;
+    int32_t rh_fraction = humidity_c100 % HEAT_INDEX_STEP_RH100;
+    if(row >= HEAT_INDEX_ROWS - 1)
+    {
+        row = HEAT_INDEX_ROWS - 2;
+        rh_fraction = HEAT_INDEX_STEP_RH100;
+    }
+
+    int32_t low_rh  = heat_index_table_f10[row][column] +
+                      ((heat_index_table_f10[row][column + 1] - heat_index_table_f10[row][column]) * t_fraction) / HEAT_INDEX_STEP_F10;
+    int32_t high_rh = heat_index_table_f10[row + 1][column] +
+                      ((heat_index_table_f10[row + 1][column + 1] - heat_index_table_f10[row + 1][column]) * t_fraction) / HEAT_INDEX_STEP_F10;
+    return low_rh + ((high_rh - low_rh) * rh_fraction) / HEAT_INDEX_STEP_RH100;
+}
+
+/**********************************
+ * @brief Computes dew point, absolute humidity and heat index from one SHT4x reading, using only integer math.
+ *        Called by the temperature/humidity task each time a reading passes CRC and the pre-filter
+ * @param raw_temperature is the raw 16 bit temperature word from the sensor
+ * @param raw_humidity is the raw 16 bit humidity word from the sensor
+ *********************************/
+void update_derived_metrics(uint16_t raw_temperature, uint16_t raw_humidity)
+{
+    derived_metrics_t metrics = {0};
+
+    // Conversion formulas from the SHT4x datasheet, scaled to hundredths
+    int32_t temperature_c100 = -4500 + (int32_t)((17500UL * raw_temperature) / 65535UL);
+    int32_t humidity_c100 = -600 + (int32_t)((12500UL * raw_humidity) / 65535UL);
+    if(humidity_c100 < 0)
+    {
+        humidity_c100 = 0;
+    }
+    else if(humidity_c100 > 10000)
+    {
+        humidity_c100 = 10000;
+    }
+
+    uint32_t vapor_pressure_dpa = (uint32_t)(((uint64_t)saturation_vapor_pressure(temperature_c100) * humidity_c100) / 10000);
+    int32_t dew_point_c100 = dew_point_from_vapor_pressure(vapor_pressure_dpa);
+    int32_t temperature_f10 = (temperature_c100 * 9) / 50 + 320;
+
+    metrics.temperature_c100 = temperature_c100;
+    metrics.humidity_c100 = humidity_c100;
+    metrics.dew_point_c100 = dew_point_c100;
+    metrics.dew_point_f10 = (dew_point_c100 * 9) / 50 + 320;
+    metrics.absolute_humidity_x100 = (uint16_t)(((uint64_t)vapor_pressure_dpa * ABS_HUMIDITY_CONSTANT_X10000) /
+                                                (10UL * (uint32_t)(temperature_c100 + ZERO_C_IN_CENTI_KELVIN)));
+    metrics.heat_index_f10 = heat_index(temperature_f10, humidity_c100);
+    metrics.valid = true;
+
+    taskENTER_CRITICAL(&derived_metrics_lock);
+    latest_derived_metrics = metrics;
+    taskEXIT_CRITICAL(&derived_metrics_lock);
+}
+
+/**********************************
+ * @brief Copies out the most recent derived metrics for the display, alarms, or telemetry
+ * @returns false if no reading has been processed yet
+ *********************************/
+bool get_derived_metrics(derived_metrics_t *metrics)
+{
+    if(metrics == NULL)
+    {
+        return false;
+    }
+    taskENTER_CRITICAL(&derived_metrics_lock);
+    *metrics = latest_derived_metrics;
+    taskEXIT_CRITICAL(&derived_metrics_lock);
+    return metrics->valid;
+}
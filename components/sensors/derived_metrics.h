@@ -0,0 +1,23 @@
+#ifndef DERIVED_METRICS_H
+#define DERIVED_METRICS_H
+
+#include "stdint.h"
+#include "stdbool.h"
+
+/************************************
+ * Quantities derived from one SHT4x reading. All values are fixed point, the suffix gives the scale
+ ***********************************/
+typedef struct {
+    bool     valid;
+    int16_t  temperature_c100;         // Temperature in 0.01 C
+    uint16_t humidity_c100;            // Relative humidity in 0.01 %
+    int16_t  dew_point_c100;           // Dew point in 0.01 C
+    int16_t  dew_point_f10;            // Dew point in 0.1 F, matching the units shown on the display
+    uint16_t absolute_humidity_x100;   // Absolute humidity in 0.01 g/m3
+    int16_t  heat_index_f10;           // NWS heat index in 0.1 F
+} derived_metrics_t;
+
+void update_derived_metrics(uint16_t raw_temperature, uint16_t raw_humidity);
+bool get_derived_metrics(derived_metrics_t *metrics);
+
+#endif  // DERIVED_METRICS_H
@@ -14,6 +14,13 @@
 #include "esp_check.h"
 #include "co2_sensor.h"
 #include "voc_sensor.h"
+#include "sensor_statistics.h"
+#include "sensor_prefilter.h"
+#include "co2_trend.h"
+#include "co2_ventilation.h"
+#include "iaq_ui.h"
+#include "buzzer_patterns.h"
+#include "sys/time.h"
 
 #define CRC_INIT          0xFF
 #define CRC_POLYNOMIAL    0x31
@@ -25,10 +32,10 @@ bool safety_buzzer_status = false;
 // create an instance of this struct to be used 
 // RTC_DATA_ATTR will make sure this struct is not lost during deep sleep so it holds onto all readings
 RTC_DATA_ATTR sensor_readings_t sensor_data_buffer = {
-    .co2_generally_unsafe_value = 3000,
-    .co2_user_threshold         = 1500,
-    .voc_user_threshold         = 300, 
-    .voc_generally_unsafe_value = 600
+    .co2_generally_unsafe_value = DEFAULT_CO2_UNSAFE_VALUE,
+    .co2_user_threshold         = DEFAULT_CO2_USER_THRESHOLD,
+    .voc_user_threshold         = DEFAULT_VOC_USER_THRESHOLD,
+    .voc_generally_unsafe_value = DEFAULT_VOC_UNSAFE_VALUE
 };
 
 
@@ -58,8 +65,81 @@ uint8_t crc_check(const uint8_t* data, uint16_t count)
 }
 
 /*****************
- * @brief The two functions below are used by the deep sleep task to check the status of the two buzzers
- * If either one of these functions returns true (either buzzer is on), the device will avoid entering deep sleep
+ * @brief Current time in seconds. The system clock keeps running through deep sleep, unlike esp_timer, so times
+ *        saved in RTC memory on earlier wake cycles stay comparable
+ ****************/
+uint32_t get_persistent_time_seconds()
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (uint32_t)now.tv_sec;
+}
+
+/*****************
+ * @brief Every CRC-valid reading goes through here. The reading first passes the sensor's pre-filter, and only if it is
+ *        accepted is it added to the sliding-window statistics and to the buffer used for the 10-reading average
+ * @param metric is which quantity the reading belongs to
+ * @param reading is the converted sensor value
+ * @returns true if the reading was accepted
+ ****************/
+bool store_sensor_reading(sensor_metric_t metric, uint16_t reading)
+{
+    uint16_t filtered_reading = 0;
+    uint16_t *readings = NULL;
+    uint8_t *reading_index = NULL;
+
+    if(!sensor_prefilter_apply(metric, reading, &filtered_reading))
+    {
+        return false;
+    }
+
+    sensor_stats_add_sample(metric, filtered_reading);
+    sensor_data_buffer.latest_reading[metric] = filtered_reading;
+
+    switch(metric)
+    {
+        case SENSOR_METRIC_TEMPERATURE:
+            readings = sensor_data_buffer.temperature;
+            reading_index = &sensor_data_buffer.temp_reading_index;
+            break;
+        case SENSOR_METRIC_HUMIDITY:
+            readings = sensor_data_buffer.humidity;
+            reading_index = &sensor_data_buffer.humid_reading_index;
+            break;
+        case SENSOR_METRIC_CO2:
+            readings = sensor_data_buffer.co2_concentration;
+            reading_index = &sensor_data_buffer.co2_reading_index;
+            co2_trend_add_sample(filtered_reading);
+            co2_ventilation_add_sample(filtered_reading);
+            break;
+        case SENSOR_METRIC_VOC:
+            readings = sensor_data_buffer.voc_measurement;
+            reading_index = &sensor_data_buffer.voc_reading_index;
+            break;
+        default:
+            return false;
+    }
+
+    // Only fill up to 10 readings, the display task empties the buffer once it has averaged them.
+    // The display task sleeps until the buffer is full
+    if(*reading_index < MAX_SENSOR_READINGS)
+    {
+        readings[*reading_index] = filtered_reading;
+        (*reading_index)++;
+        if(*reading_index == MAX_SENSOR_READINGS)
+        {
+            notify_display_task(DISPLAY_NOTIFY_READINGS_READY);
+        }
+    }
+
+    // The safety alarms look at every reading rather than waiting for the next 10-reading average
+    notify_display_task(DISPLAY_NOTIFY_ALARM_INPUTS);
+    return true;
+}
+
+/*****************
+ * @brief The two functions below say whether either alarm is sounding and has not been acknowledged. The power
+ * button uses these to decide what a press acknowledges
  ********************/
 bool is_safety_buzzer_on()
 {
@@ -71,68 +151,36 @@ bool is_user_buzzer_on()
     return user_buzzer_status;
 }
 
-// Function to turn the user threshold buzzer off since it can be used in two places
-void turn_user_buzzer_off()
-{
-    esp_err_t err = ESP_FAIL;
-    err = ledc_set_duty_and_update(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0, 0,0);
-    if(err != ESP_OK)
-    {
-        ESP_LOGE("BZR", "Error turning buzzer off: %s", esp_err_to_name(err));
-    }
-    user_buzzer_status = false;
-}
-
 /****************************************
- * @brief compare measured average value against the generally unsafe values, if it has been exceeded, turn on large buzzer
+ * @brief Starts or stops the user threshold alarm, bursts of escalating chirps played by the LEDC fade hardware that
+ *        repeat until it is stopped. Called by the alarm rules only when the alarm should change
  ****************************************/
-void check_general_safety_value()
+void set_user_buzzer(bool on)
 {
-    if(((sensor_data_buffer.average_voc > sensor_data_buffer.voc_generally_unsafe_value)|| (sensor_data_buffer.average_co2 > sensor_data_buffer.co2_generally_unsafe_value)) && !has_safety_buzzer_been_acked())
+    if(on)
     {
-        gpio_set_level(LARGE_BUZZER_PIN, 1);
-        safety_buzzer_status = true;
+        buzzer_play(BUZZER_USER, BUZZER_PATTERN_ESCALATING_CHIRPS);
     }
-    // Levels returned below threshold, and the buzzer currently is acked
-    else if(!((sensor_data_buffer.average_voc > sensor_data_buffer.voc_generally_unsafe_value) || (sensor_data_buffer.average_co2 > sensor_data_buffer.co2_generally_unsafe_value)) && has_safety_buzzer_been_acked())
+    else
     {
-        // turn buzzer off since levels returned below threshold, and then unack it so that next time the threshold is reached, it will not already be acked
-        gpio_set_level(LARGE_BUZZER_PIN, 0);
-        safety_buzzer_status = false;
-        reset_safety_buzzer_ack();
-    }
-    else // Levels are still above threshold, but buzzer has been acked
-    {
-        gpio_set_level(LARGE_BUZZER_PIN, 0);
-        safety_buzzer_status = false;
-
+        buzzer_stop(BUZZER_USER);
     }
+    user_buzzer_status = on;
 }
 
-/*********************************
- * @brief If either the CO2 or VOC user-set threshold has been reached or exceeded, and the buzzer has not yet been acknowledged by the user, turn the buzzer on
- ********************************/
-void check_user_threshold()
+/****************************************
+ * @brief Starts or stops the large buzzer for the generally unsafe values, which repeats SOS until it is stopped.
+ *        Called by the alarm rules only when the alarm should change
+ ****************************************/
+void set_safety_buzzer(bool on)
 {
-    esp_err_t err = ESP_FAIL;
-    // Compare measured values to thresholds, and if it has been exceeded, only proceed if the buzzer has not yet been acknowledged
-    if(((sensor_data_buffer.average_voc > sensor_data_buffer.voc_user_threshold) || (sensor_data_buffer.average_co2 > sensor_data_buffer.co2_user_threshold)) && !has_user_buzzer_been_acked())
+    if(on)
     {
-        err = ledc_set_duty_and_update(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0, 4096,0);  // 50% duty cycle
-        if(err != ESP_OK)
-        {
-            ESP_LOGE("BZR", "Error turning buzzer on: %s", esp_err_to_name(err));
-        }
-        user_buzzer_status = true;
+        buzzer_play(BUZZER_SAFETY, BUZZER_PATTERN_SOS);
     }
-    // else if the buzzers have returned below their threshold, and the buzzer is still acked, reset  the ack
-    else if(!((sensor_data_buffer.average_voc > sensor_data_buffer.voc_user_threshold) || (sensor_data_buffer.average_co2 > sensor_data_buffer.co2_user_threshold)) && has_user_buzzer_been_acked())
-    { 
-        reset_user_buzzer_ack();
-        turn_user_buzzer_off();
-    }
-    else // Levels are still above threshold, but buzzer has been acked
+    else
     {
-        turn_user_buzzer_off();
+        buzzer_stop(BUZZER_SAFETY);
     }
-}
\ No newline at end of file
+    safety_buzzer_status = on;
+}
@@ -8,6 +8,24 @@
 #define I2C_TIMEOUT         10
 #define MAX_SENSOR_READINGS 10
 
+// Thresholds on a fresh power on. The user thresholds also go back to these when they are reset from the setpoint
+// screens
+#define DEFAULT_CO2_USER_THRESHOLD  1000
+#define DEFAULT_VOC_USER_THRESHOLD  300
+#define DEFAULT_CO2_UNSAFE_VALUE    3000
+#define DEFAULT_VOC_UNSAFE_VALUE    600
+
+/************************************
+ * Every quantity the sensors produce. Used to index the per-metric processing stages (statistics, filters, etc.)
+ ***********************************/
+typedef enum {
+    SENSOR_METRIC_TEMPERATURE = 0,
+    SENSOR_METRIC_HUMIDITY,
+    SENSOR_METRIC_CO2,
+    SENSOR_METRIC_VOC,
+    SENSOR_METRIC_COUNT
+} sensor_metric_t;
+
 uint8_t crc_check(const uint8_t* data, uint16_t count);
 bool is_user_buzzer_on();
 bool is_safety_buzzer_on();
@@ -25,14 +43,17 @@ typedef struct {
     uint16_t average_temp;
     uint16_t average_humidity;
     uint16_t average_voc;
+    uint16_t latest_reading[SENSOR_METRIC_COUNT];  // Last accepted reading of each metric, for the safety alarms
     uint16_t co2_user_threshold;
     uint16_t co2_generally_unsafe_value;
     uint16_t voc_user_threshold;
     uint16_t voc_generally_unsafe_value;
 } sensor_readings_t;
 
-void check_general_safety_value();
-void check_user_threshold();
+void set_user_buzzer(bool on);
+void set_safety_buzzer(bool on);
+bool store_sensor_reading(sensor_metric_t metric, uint16_t reading);
+uint32_t get_persistent_time_seconds();
 extern sensor_readings_t sensor_data_buffer;
 
 #endif  //SENSOR_TASKS_H
@@ -0,0 +1,216 @@
+#include "sensor_prefilter.h"
+#include "general_sensors.h"
+#include "string.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+
+static const char *TAG = "PREFILTER";
+
+// MAD to standard deviation scale factor for normally distributed noise (1.4826), x10000
+#define MAD_TO_SIGMA_X10000  14826
+
+// Minimum accepted history before the Hampel filter starts judging samples
+#define HAMPEL_MIN_HISTORY   3
+
+/************************************
+ * Filter settings for each sensor. Temperature is in F, humidity in %rH, CO2 in ppm and VOC in raw sensor ticks
+ ***********************************/
+static const sensor_prefilter_config_t prefilter_config[SENSOR_METRIC_COUNT] = {
+    [SENSOR_METRIC_TEMPERATURE] = {
+        .median_length = 1,
+        .hampel_enabled = false,
+        .max_step = 10,
+        .max_consecutive_rejects = 3
+    },
+    [SENSOR_METRIC_HUMIDITY] = {
+        .median_length = 1,
+        .hampel_enabled = false,
+        .max_step = 15,
+        .max_consecutive_rejects = 3
+    },
+    [SENSOR_METRIC_CO2] = {
+        .median_length = 3,
+        .hampel_enabled = true,
+        .hampel_threshold_x10 = 30,
+        .hampel_min_deviation = 150,
+        .max_step = 1000,
+        .max_consecutive_rejects = 3
+    },
+    [SENSOR_METRIC_VOC] = {
+        .median_length = 3,
+        .hampel_enabled = true,
+        .hampel_threshold_x10 = 30,
+        .hampel_min_deviation = 1000,
+        .max_step = 5000,
+        .max_consecutive_rejects = 3
+    }
+};
+
+RTC_DATA_ATTR static sensor_prefilter_state_t prefilter_state[SENSOR_METRIC_COUNT];
+RTC_DATA_ATTR static sensor_prefilter_diagnostics_t prefilter_diagnostics[SENSOR_METRIC_COUNT];
+
+/**********************************
+ * @brief Returns the median of a small array without modifying it. Only used on arrays of at most PREFILTER_HAMPEL_HISTORY
+ *        values, so a copy and an insertion sort are cheaper than anything clever
+ *********************************/
+static uint16_t median_of(const uint16_t *values, uint8_t count)
+{
+    uint16_t sorted[PREFILTER_HAMPEL_HISTORY];
+
+    for(uint8_t i = 0; i < count; i++)
+    {
+        uint16_t value = values[i];
+        uint8_t j = i;
+        while(j > 0 && sorted[j - 1] > value)
+        {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = value;
+    }
+    return sorted[count / 2];
+}
+
+/**********************************
+ * @brief Hampel test: a sample is an outlier if it is further from the median of recent accepted samples than
+ *        the configured number of estimated standard deviations, where the deviation estimate is the scaled MAD
+ * @returns true if the sample is an outlier
+ *********************************/
+static bool is_hampel_outlier(const sensor_prefilter_config_t *config, const sensor_prefilter_state_t *state, uint16_t value)
+{
+    if(!config->hampel_enabled || state->hampel_count < HAMPEL_MIN_HISTORY)
+    {
+        return false;
+    }
+
+    uint16_t median = median_of(state->hampel_history, state->hampel_count);
+
+    uint16_t abs_deviations[PREFILTER_HAMPEL_HISTORY];
+    for(uint8_t i = 0; i < state->hampel_count; i++)
+    {
+        int32_t diff = (int32_t)state->hampel_history[i] - median;
+        abs_deviations[i] = (diff < 0) ? -diff : diff;
+    }
+    uint32_t mad = median_of(abs_deviations, state->hampel_count);
+
+    // In 64 bits, the product overflows 32 bits once the MAD is in the thousands, which VOC raw ticks reach.
+    // A deviation can never be more than UINT16_MAX, so larger thresholds are clamped there
+    uint64_t scaled_threshold = ((uint64_t)mad * MAD_TO_SIGMA_X10000 * config->hampel_threshold_x10) / 100000;
+    uint32_t threshold = (scaled_threshold > UINT16_MAX) ? UINT16_MAX : (uint32_t)scaled_threshold;
+    if(threshold < config->hampel_min_deviation)
+    {
+        threshold = config->hampel_min_deviation;
+    }
+
+    int32_t deviation = (int32_t)value - median;
+    if(deviation < 0)
+    {
+        deviation = -deviation;
+    }
+    return (uint32_t)deviation > threshold;
+}
+
+/**********************************
+ * @brief Clears the filter history so the next sample starts a new baseline
+ *********************************/
+static void reseed_prefilter(sensor_prefilter_state_t *state)
+{
+    state->hampel_count = 0;
+    state->hampel_next = 0;
+    state->median_count = 0;
+    state->median_next = 0;
+    state->consecutive_rejects = 0;
+}
+
+/**********************************
+ * @brief Runs a new CRC-valid sample through the sensor's pre-filter stages: the rate-of-change gate, the Hampel filter,
+ *        then median-of-N smoothing. Rejected samples are counted in the sensor's diagnostics
+ * @param metric is which quantity the sample belongs to
+ * @param raw_value is the sample as converted by the sensor task
+ * @param filtered_value is used as an output parameter, only written when the sample is accepted
+ * @returns true if the sample was accepted and should be stored
+ *********************************/
+bool sensor_prefilter_apply(sensor_metric_t metric, uint16_t raw_value, uint16_t *filtered_value)
+{
+    if(metric >= SENSOR_METRIC_COUNT)
+    {
+        return false;
+    }
+    const sensor_prefilter_config_t *config = &prefilter_config[metric];
+    sensor_prefilter_state_t *state = &prefilter_state[metric];
+    sensor_prefilter_diagnostics_t *diagnostics = &prefilter_diagnostics[metric];
+
+    bool has_history = (state->hampel_count > 0);
+    bool rejected = false;
+
+    if(has_history && config->max_step > 0)
+    {
+        int32_t step = (int32_t)raw_value - state->last_accepted;
+        if(step > config->max_step || step < -config->max_step)
+        {
+            diagnostics->rejected_rate_of_change++;
+            rejected = true;
+        }
+    }
+    if(!rejected && is_hampel_outlier(config, state, raw_value))
+    {
+        diagnostics->rejected_hampel++;
+        rejected = true;
+    }
+
+    if(rejected)
+    {
+        state->consecutive_rejects++;
+        if(state->consecutive_rejects < config->max_consecutive_rejects)
+        {
+            ESP_LOGW(TAG, "Rejected sample %d for sensor %d", raw_value, metric);
+            return false;
+        }
+        // The same "outlier" keeps coming back, so the level really changed. Start over from this sample
+        ESP_LOGW(TAG, "Sensor %d re-seeded at %d after %d rejections", metric, raw_value, state->consecutive_rejects);
+        diagnostics->reseeds++;
+        reseed_prefilter(state);
+    }
+    state->consecutive_rejects = 0;
+    state->last_accepted = raw_value;
+
+    state->hampel_history[state->hampel_next] = raw_value;
+    state->hampel_next = (state->hampel_next + 1) % PREFILTER_HAMPEL_HISTORY;
+    if(state->hampel_count < PREFILTER_HAMPEL_HISTORY)
+    {
+        state->hampel_count++;
+    }
+
+    uint8_t median_length = (config->median_length > PREFILTER_MAX_MEDIAN) ? PREFILTER_MAX_MEDIAN : config->median_length;
+    if(median_length <= 1)
+    {
+        *filtered_value = raw_value;
+    }
+    else
+    {
+        state->median_history[state->median_next] = raw_value;
+        state->median_next = (state->median_next + 1) % median_length;
+        if(state->median_count < median_length)
+        {
+            state->median_count++;
+        }
+        *filtered_value = median_of(state->median_history, state->median_count);
+    }
+
+    diagnostics->accepted++;
+    return true;
+}
+
+/**********************************
+ * @brief Copies out the accepted and rejected sample counters for one sensor
+ * @returns false if the metric is not valid
+ *********************************/
+bool sensor_prefilter_get_diagnostics(sensor_metric_t metric, sensor_prefilter_diagnostics_t *diagnostics)
+{
+    if(metric >= SENSOR_METRIC_COUNT || diagnostics == NULL)
+    {
+        return false;
+    }
+    memcpy(diagnostics, &prefilter_diagnostics[metric], sizeof(*diagnostics));
+    return true;
+}
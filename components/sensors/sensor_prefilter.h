@@ -0,0 +1,52 @@
+#ifndef SENSOR_PREFILTER_H
+#define SENSOR_PREFILTER_H
+
+#include "stdint.h"
+#include "stdbool.h"
+#include "general_sensors.h"
+
+// Number of accepted samples the Hampel filter compares a new sample against
+#define PREFILTER_HAMPEL_HISTORY  7
+// Longest median-of-N window that can be configured
+#define PREFILTER_MAX_MEDIAN      5
+
+/************************************
+ * Per-sensor pre-filter settings. Each stage can be turned off on its own
+ ***********************************/
+typedef struct {
+    uint8_t  median_length;            // 1 passes samples through, 3 or 5 outputs the median of the last N accepted samples
+    bool     hampel_enabled;
+    uint8_t  hampel_threshold_x10;     // Rejection threshold in scaled MADs (estimated standard deviations) x10, 30 = 3.0 sigma
+    uint16_t hampel_min_deviation;     // Deviations below this are never rejected, so a flat history (MAD of 0) does not reject normal noise
+    uint16_t max_step;                 // Largest allowed change from the last accepted sample, 0 disables the rate-of-change gate
+    uint8_t  max_consecutive_rejects;  // After this many rejections in a row the level is assumed to have really changed and the filter re-seeds
+} sensor_prefilter_config_t;
+
+/************************************
+ * Filter history for one sensor, kept in RTC memory so it survives deep sleep
+ ***********************************/
+typedef struct {
+    uint16_t hampel_history[PREFILTER_HAMPEL_HISTORY];
+    uint8_t  hampel_next;
+    uint8_t  hampel_count;
+    uint16_t median_history[PREFILTER_MAX_MEDIAN];
+    uint8_t  median_next;
+    uint8_t  median_count;
+    uint16_t last_accepted;
+    uint8_t  consecutive_rejects;
+} sensor_prefilter_state_t;
+
+/************************************
+ * Diagnostics counters for one sensor
+ ***********************************/
+typedef struct {
+    uint32_t accepted;
+    uint32_t rejected_hampel;
+    uint32_t rejected_rate_of_change;
+    uint32_t reseeds;
+} sensor_prefilter_diagnostics_t;
+
+bool sensor_prefilter_apply(sensor_metric_t metric, uint16_t raw_value, uint16_t *filtered_value);
+bool sensor_prefilter_get_diagnostics(sensor_metric_t metric, sensor_prefilter_diagnostics_t *diagnostics);
+
+#endif  // SENSOR_PREFILTER_H
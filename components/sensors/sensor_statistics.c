@@ -0,0 +1,334 @@
+#include "sensor_statistics.h"
+#include "general_sensors.h"
+#include "string.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_sleep.h"
+
+#define P2_MEDIAN_QUANTILE  0.50f
+#define P2_P95_QUANTILE     0.95f
+// Below this many samples a restarted estimator is too coarse for tail quantiles, so the last window's result is reported
+#define P2_WARMUP_SAMPLES   (STATS_WINDOW_SIZE / 2)
+
+#define WINDOW_STATS_INITIALIZER { .median.quantile = P2_MEDIAN_QUANTILE, .p95.quantile = P2_P95_QUANTILE }
+
+// Kept in RTC memory like sensor_data_buffer so the windows keep filling across deep sleep cycles
+RTC_DATA_ATTR static sensor_window_stats_t window_stats[SENSOR_METRIC_COUNT] = {
+    [SENSOR_METRIC_TEMPERATURE] = WINDOW_STATS_INITIALIZER,
+    [SENSOR_METRIC_HUMIDITY]    = WINDOW_STATS_INITIALIZER,
+    [SENSOR_METRIC_CO2]         = WINDOW_STATS_INITIALIZER,
+    [SENSOR_METRIC_VOC]         = WINDOW_STATS_INITIALIZER
+};
+
+// Sensor tasks add samples while the display task reads summaries, so every access goes through this lock
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**********************************
+ * @brief Adds one observation to a P-squared estimator. The first five observations are kept sorted and become the markers,
+ *        after that each observation only moves the markers. Once a full window has been seen, the estimate is saved and the
+ *        estimator restarts so the result tracks recent data rather than all data since power on
+ * @param est is the estimator to update
+ * @param value is the new observation
+ *********************************/
+static void p2_add_sample(p2_estimator_t *est, float value)
+{
+    float *height = est->marker_height;
+    uint8_t *position = est->marker_position;
+    float p = est->quantile;
+
+    if(est->sample_count < P2_MARKER_COUNT)  // Still collecting the initial markers, insert in sorted order
+    {
+        uint8_t i = est->sample_count;
+        while(i > 0 && height[i - 1] > value)
+        {
+            height[i] = height[i - 1];
+            i--;
+        }
+        height[i] = value;
+        est->sample_count++;
+
+        if(est->sample_count == P2_MARKER_COUNT)
+        {
+            for(uint8_t j = 0; j < P2_MARKER_COUNT; j++)
+            {
+                position[j] = j + 1;
+            }
+            est->desired_position[0] = 1.0f;
+            est->desired_position[1] = 1.0f + 2.0f * p;
+            est->desired_position[2] = 1.0f + 4.0f * p;
+            est->desired_position[3] = 3.0f + 2.0f * p;
+            est->desired_position[4] = 5.0f;
+        }
+        return;
+    }
+
+    // Find the cell the value falls in, extending the extreme markers if needed
+    uint8_t cell = 0;
+    if(value < height[0])
+    {
+        height[0] = value;
+        cell = 0;
+    }
+    else if(value >= height[4])
+    {
+        height[4] = value;
+        cell = 3;
+    }
+    else
+    {
+        while(cell < 3 && value >= height[cell + 1])
+        {
+            cell++;
+        }
+    }
+
+    for(uint8_t i = cell + 1; i < P2_MARKER_COUNT; i++)
+    {
+        position[i]++;
+    }
+    est->desired_position[1] += p / 2.0f;
+    est->desired_position[2] += p;
+    est->desired_position[3] += (1.0f + p) / 2.0f;
+    est->desired_position[4] += 1.0f;
+
+    // Move the three middle markers toward their desired positions with the piecewise-parabolic formula
+    for(uint8_t i = 1; i < P2_MARKER_COUNT - 1; i++)
+    {
+        float offset = est->desired_position[i] - position[i];
+        if((offset >= 1.0f && position[i + 1] - position[i] > 1) || (offset <= -1.0f && position[i - 1] - position[i] < -1))
+        {
+            int8_t step = (offset > 0) ? 1 : -1;
+            float n_prev = position[i - 1];
+            float n_curr = position[i];
+            float n_next = position[i + 1];
+
+            float parabolic = height[i] + (step / (n_next - n_prev)) *
+                              ((n_curr - n_prev + step) * (height[i + 1] - height[i]) / (n_next - n_curr) +
+                               (n_next - n_curr - step) * (height[i] - height[i - 1]) / (n_curr - n_prev));
+
+            if(height[i - 1] < parabolic && parabolic < height[i + 1])
+            {
+                height[i] = parabolic;
+            }
+            else  // Parabolic prediction left the bracket, fall back to linear
+            {
+                height[i] += step * (height[i + step] - height[i]) / (float)(position[i + step] - position[i]);
+            }
+            position[i] += step;
+        }
+    }
+
+    est->sample_count++;
+    if(est->sample_count >= STATS_WINDOW_SIZE)  // Window complete, keep its result and start over
+    {
+        est->last_window_estimate = height[2];
+        est->has_last_window = true;
+        est->sample_count = 0;
+    }
+}
+
+/**********************************
+ * @brief Returns the current quantile estimate. While a restarted estimator is still warming up, the previous window's
+ *        result is used. On a fresh start, the best available value is used
+ *********************************/
+static float p2_get_estimate(const p2_estimator_t *est)
+{
+    if(est->has_last_window && est->sample_count < P2_WARMUP_SAMPLES)
+    {
+        return est->last_window_estimate;
+    }
+    if(est->sample_count >= P2_MARKER_COUNT)
+    {
+        return est->marker_height[2];
+    }
+    if(est->sample_count == 0)
+    {
+        return 0.0f;
+    }
+    return est->marker_height[(uint8_t)(est->quantile * (est->sample_count - 1) + 0.5f)];
+}
+
+/**********************************
+ * @brief The deques below are rings of slot indices into the sample ring, sized to the window so they can never overflow
+ *********************************/
+static uint8_t deque_back(const uint8_t *deque, uint8_t head, uint8_t count)
+{
+    return deque[(head + count - 1) % STATS_WINDOW_SIZE];
+}
+
+static void deque_push_back(uint8_t *deque, uint8_t head, uint8_t *count, uint8_t slot)
+{
+    deque[(head + *count) % STATS_WINDOW_SIZE] = slot;
+    (*count)++;
+}
+
+static void deque_pop_front(uint8_t *head, uint8_t *count)
+{
+    *head = (*head + 1) % STATS_WINDOW_SIZE;
+    (*count)--;
+}
+
+/**********************************
+ * @brief Recomputes the mean and sum of squared differences from the samples in the window. The sliding Welford update
+ *        slowly accumulates float rounding error, so this runs once per window length, keeping the cost O(1) amortized
+ *********************************/
+static void resync_welford(sensor_window_stats_t *stats)
+{
+    float sum = 0.0f;
+    for(uint8_t i = 0; i < stats->sample_count; i++)
+    {
+        sum += stats->samples[i];
+    }
+    stats->mean = sum / stats->sample_count;
+
+    float sum_sq_diff = 0.0f;
+    for(uint8_t i = 0; i < stats->sample_count; i++)
+    {
+        float diff = stats->samples[i] - stats->mean;
+        sum_sq_diff += diff * diff;
+    }
+    stats->sum_sq_diff = sum_sq_diff;
+    stats->samples_since_resync = 0;
+}
+
+/**********************************
+ * @brief Adds a validated reading to the metric's sliding window. Called by the sensor tasks for every reading that passed
+ *        the CRC check, independently of the 10-sample averaging buffer
+ * @param metric is which quantity the reading belongs to
+ * @param value is the reading in the same units stored in sensor_data_buffer
+ *********************************/
+void sensor_stats_add_sample(sensor_metric_t metric, uint16_t value)
+{
+    if(metric >= SENSOR_METRIC_COUNT)
+    {
+        return;
+    }
+    sensor_window_stats_t *stats = &window_stats[metric];
+
+    taskENTER_CRITICAL(&stats_lock);
+
+    uint8_t slot = stats->next_slot;
+    bool window_full = (stats->sample_count == STATS_WINDOW_SIZE);
+    uint16_t leaving_value = stats->samples[slot];
+
+    // The slot about to be overwritten holds the oldest sample, drop it from the front of either deque
+    if(window_full)
+    {
+        if(stats->min_count > 0 && stats->min_deque[stats->min_head] == slot)
+        {
+            deque_pop_front(&stats->min_head, &stats->min_count);
+        }
+        if(stats->max_count > 0 && stats->max_deque[stats->max_head] == slot)
+        {
+            deque_pop_front(&stats->max_head, &stats->max_count);
+        }
+    }
+    stats->samples[slot] = value;
+
+    // Anything newer that is not smaller (or larger) than this value can never be the window minimum (or maximum) again
+    while(stats->min_count > 0 && stats->samples[deque_back(stats->min_deque, stats->min_head, stats->min_count)] >= value)
+    {
+        stats->min_count--;
+    }
+    deque_push_back(stats->min_deque, stats->min_head, &stats->min_count, slot);
+
+    while(stats->max_count > 0 && stats->samples[deque_back(stats->max_deque, stats->max_head, stats->max_count)] <= value)
+    {
+        stats->max_count--;
+    }
+    deque_push_back(stats->max_deque, stats->max_head, &stats->max_count, slot);
+
+    // Welford update, replacing the leaving sample once the window is full
+    if(window_full)
+    {
+        float old_mean = stats->mean;
+        float delta = (float)value - leaving_value;
+        stats->mean += delta / STATS_WINDOW_SIZE;
+        stats->sum_sq_diff += delta * ((float)value - stats->mean + leaving_value - old_mean);
+    }
+    else
+    {
+        stats->sample_count++;
+        float delta = (float)value - stats->mean;
+        stats->mean += delta / stats->sample_count;
+        stats->sum_sq_diff += delta * ((float)value - stats->mean);
+    }
+    if(stats->sum_sq_diff < 0.0f)
+    {
+        stats->sum_sq_diff = 0.0f;
+    }
+
+    stats->next_slot = (slot + 1) % STATS_WINDOW_SIZE;
+    stats->samples_since_resync++;
+    if(stats->samples_since_resync >= STATS_WINDOW_SIZE)
+    {
+        resync_welford(stats);
+    }
+
+    p2_add_sample(&stats->median, value);
+    p2_add_sample(&stats->p95, value);
+
+    taskEXIT_CRITICAL(&stats_lock);
+}
+
+/**********************************
+ * @brief Gets the min, max, median, 95th percentile, mean, and variance of the metric's current window
+ * @param metric is which quantity to summarize
+ * @param summary is used as an output parameter
+ * @returns false if the metric has not received any samples yet
+ *********************************/
+bool sensor_stats_get_summary(sensor_metric_t metric, sensor_window_summary_t *summary)
+{
+    if(metric >= SENSOR_METRIC_COUNT || summary == NULL)
+    {
+        return false;
+    }
+    sensor_window_stats_t *stats = &window_stats[metric];
+
+    memset(summary, 0, sizeof(*summary));
+
+    taskENTER_CRITICAL(&stats_lock);
+    if(stats->sample_count == 0)
+    {
+        taskEXIT_CRITICAL(&stats_lock);
+        return false;
+    }
+
+    summary->sample_count = stats->sample_count;
+    summary->min    = stats->samples[stats->min_deque[stats->min_head]];
+    summary->max    = stats->samples[stats->max_deque[stats->max_head]];
+    summary->median = (uint16_t)(p2_get_estimate(&stats->median) + 0.5f);
+    summary->p95    = (uint16_t)(p2_get_estimate(&stats->p95) + 0.5f);
+    summary->mean   = (uint16_t)(stats->mean + 0.5f);
+    summary->variance = (stats->sample_count > 1) ? stats->sum_sq_diff / (stats->sample_count - 1) : 0.0f;
+    taskEXIT_CRITICAL(&stats_lock);
+
+    return true;
+}
+
+/**********************************
+ * @brief Copies the most recent samples of the metric's window, oldest first
+ * @param metric is which quantity to read
+ * @param values is used as an output parameter, it must hold max_count samples
+ * @param max_count is the most samples to copy, the newest ones are kept if the window holds more
+ * @returns the number of samples copied
+ *********************************/
+uint8_t sensor_stats_get_history(sensor_metric_t metric, uint16_t *values, uint8_t max_count)
+{
+    if(metric >= SENSOR_METRIC_COUNT || values == NULL)
+    {
+        return 0;
+    }
+    sensor_window_stats_t *stats = &window_stats[metric];
+
+    taskENTER_CRITICAL(&stats_lock);
+    uint8_t count = (stats->sample_count < max_count) ? stats->sample_count : max_count;
+    uint8_t slot = (stats->next_slot + STATS_WINDOW_SIZE - count) % STATS_WINDOW_SIZE;
+    for(uint8_t i = 0; i < count; i++)
+    {
+        values[i] = stats->samples[slot];
+        slot = (slot + 1) % STATS_WINDOW_SIZE;
+    }
+    taskEXIT_CRITICAL(&stats_lock);
+
+    return count;
+}
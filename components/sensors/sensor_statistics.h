@@ -0,0 +1,68 @@
+#ifndef SENSOR_STATISTICS_H
+#define SENSOR_STATISTICS_H
+
+#include "stdint.h"
+#include "stdbool.h"
+#include "general_sensors.h"
+
+// Number of most recent samples each metric's sliding window covers
+#define STATS_WINDOW_SIZE   60
+// Number of markers used by each P-squared quantile estimator
+#define P2_MARKER_COUNT     5
+
+/************************************
+ * P-squared (Jain & Chlamtac) streaming quantile estimator. Tracks one quantile with five markers
+ * instead of storing and sorting the samples
+ ***********************************/
+typedef struct {
+    float   quantile;
+    float   marker_height[P2_MARKER_COUNT];
+    float   desired_position[P2_MARKER_COUNT];
+    uint8_t marker_position[P2_MARKER_COUNT];
+    uint8_t sample_count;
+    float   last_window_estimate;   // Estimate from the previous full window, used while the current one warms up
+    bool    has_last_window;
+} p2_estimator_t;
+
+/************************************
+ * Sliding-window state for one metric. Min and max come from monotonic deques of slots in the sample ring,
+ * variance from Welford's method with removal of the sample leaving the window
+ ***********************************/
+typedef struct {
+    uint16_t samples[STATS_WINDOW_SIZE];
+    uint8_t  next_slot;
+    uint8_t  sample_count;
+
+    uint8_t  min_deque[STATS_WINDOW_SIZE];
+    uint8_t  min_head;
+    uint8_t  min_count;
+    uint8_t  max_deque[STATS_WINDOW_SIZE];
+    uint8_t  max_head;
+    uint8_t  max_count;
+
+    float    mean;
+    float    sum_sq_diff;
+    uint8_t  samples_since_resync;
+
+    p2_estimator_t median;
+    p2_estimator_t p95;
+} sensor_window_stats_t;
+
+/************************************
+ * Snapshot of one metric's window, filled in by sensor_stats_get_summary()
+ ***********************************/
+typedef struct {
+    uint8_t  sample_count;
+    uint16_t min;
+    uint16_t max;
+    uint16_t median;
+    uint16_t p95;
+    uint16_t mean;
+    float    variance;
+} sensor_window_summary_t;
+
+void sensor_stats_add_sample(sensor_metric_t metric, uint16_t value);
+bool sensor_stats_get_summary(sensor_metric_t metric, sensor_window_summary_t *summary);
+uint8_t sensor_stats_get_history(sensor_metric_t metric, uint16_t *values, uint8_t max_count);
+
+#endif  // SENSOR_STATISTICS_H
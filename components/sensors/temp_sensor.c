@@ -1,5 +1,6 @@
 #include "temp_sensor.h"
 #include "general_sensors.h"
+#include "derived_metrics.h"
 #include "esp_err.h"
 #include "esp_log.h"
 #include "driver/i2c.h"
@@ -9,6 +10,10 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
 #include "freertos/semphr.h"
+#include "wake_lock.h"
+#include "wake_scheduler.h"
+#include "boot_timeline.h"
+#include "wake_phases.h"
 
 #define TEMP_SENS_ADDR     0x44
 
@@ -60,6 +65,9 @@ void temp_humidity_task(void *parameter)
         uint16_t temperature = 0;
         uint16_t humidity = 0;
 
+        // Only measure when the scheduler says a reading is due, with the wake lock given up while waiting
+        wake_scheduler_wait_until_due(WAKE_JOB_TEMP_HUMIDITY, WAKE_LOCK_TEMP_HUMIDITY);
+
         // Create Queue to send the raw data to VOC sensor
         temp_humid_voc_queue =  xQueueCreate(1, sizeof(sensor_data));
         if(temp_humid_voc_queue == NULL)
@@ -69,17 +77,19 @@ void temp_humidity_task(void *parameter)
 
         if(xSemaphoreTake(temp_humid_mutex, pdMS_TO_TICKS(1000)) == pdTRUE)
         {
-            // Give other sensor tasks the chance to take their mutex as well, ensures it only goes into deep sleep when needed
-            vTaskDelay(pdMS_TO_TICKS(100));
-
+            boot_timeline_mark(BOOT_EVENT_FIRST_I2C_COMMAND);
+            int64_t i2c_start_us = wake_phase_begin();
             err = i2c_master_transmit(i2c_temp_device_handle, &temp_humid_measure_cmd, sizeof(temp_humid_measure_cmd), pdMS_TO_TICKS(100));
+            wake_phase_end(WAKE_PHASE_I2C, i2c_start_us);
             if(err != ESP_OK)
             {
                 ESP_LOGE(TAG, "Error with temp sensor write cmd: 0x%03X", err);
             }
             
-            vTaskDelay(pdMS_TO_TICKS(1000));
+            wake_phase_sensor_wait(1000);
+            i2c_start_us = wake_phase_begin();
             err = i2c_master_receive(i2c_temp_device_handle, sensor_data, sizeof(sensor_data), pdMS_TO_TICKS(100));
+            wake_phase_end(WAKE_PHASE_I2C, i2c_start_us);
             if(err != ESP_OK)
             {
                 ESP_LOGE(TAG, "Error with temp sensor read cmd");
@@ -95,12 +105,13 @@ void temp_humidity_task(void *parameter)
                 calculate_readable_temp_humid(sensor_data, &temperature, &humidity);
                 ESP_LOGW(TAG, "Measured Temperatue: %d\n Measured Humidity: %d", temperature, humidity);
                 
-                if((sensor_data_buffer.temp_reading_index < MAX_SENSOR_READINGS) && (sensor_data_buffer.humid_reading_index < MAX_SENSOR_READINGS))
+                bool temperature_accepted = store_sensor_reading(SENSOR_METRIC_TEMPERATURE, temperature);
+                bool humidity_accepted = store_sensor_reading(SENSOR_METRIC_HUMIDITY, humidity);
+
+                // Dew point, absolute humidity and heat index are computed here once per reading, straight from the raw words
+                if(temperature_accepted && humidity_accepted)
                 {
-                    sensor_data_buffer.temperature[sensor_data_buffer.temp_reading_index] = temperature;
-                    sensor_data_buffer.humidity[sensor_data_buffer.humid_reading_index] = humidity;
-                    sensor_data_buffer.temp_reading_index++;
-                    sensor_data_buffer.humid_reading_index++;
+                    update_derived_metrics((sensor_data[0] << 8) | sensor_data[1], (sensor_data[3] << 8) | sensor_data[4]);
                 }
             }
             else
@@ -110,7 +121,8 @@ void temp_humidity_task(void *parameter)
             }
         }
         xSemaphoreGive(temp_humid_mutex);
-         // only take one measurement before entering deep sleep
-        vTaskDelay(pdMS_TO_TICKS(5000));
+
+        // A CRC mismatch above skips this, so the reading stays due and is retried right away
+        wake_scheduler_job_done(WAKE_JOB_TEMP_HUMIDITY);
     }
 }
\ No newline at end of file
@@ -10,6 +10,10 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
 #include "esp_sleep.h"
+#include "wake_lock.h"
+#include "wake_scheduler.h"
+#include "boot_timeline.h"
+#include "wake_phases.h"
 
 #define VOC_SENS_ADDR      0x58
 
@@ -26,7 +30,9 @@ RTC_DATA_ATTR static bool voc_sensor_initialized = false;
 void init_voc_sensor()
 {
     esp_err_t err = ESP_FAIL;
+    int64_t i2c_start_us = wake_phase_begin();
     err = i2c_master_transmit(i2c_voc_device_handle, init_voc_sensor_cmd, sizeof(init_voc_sensor_cmd), pdMS_TO_TICKS(200));
+    wake_phase_end(WAKE_PHASE_I2C, i2c_start_us);
     if(err != ESP_OK)
     {
         ESP_LOGE(TAG, "Error sending init command to sensor, %s", esp_err_to_name(err));
@@ -42,15 +48,19 @@ void init_voc_sensor()
 void measure_voc_sensor()
 {
     esp_err_t err = ESP_FAIL;
+    int64_t i2c_start_us = wake_phase_begin();
     err = i2c_master_transmit(i2c_voc_device_handle, voc_measure_cmd, sizeof(voc_measure_cmd), pdMS_TO_TICKS(500));
+    wake_phase_end(WAKE_PHASE_I2C, i2c_start_us);
     if(err != ESP_OK)
     {
         ESP_LOGE(TAG, "Failed to send measure command: %s", esp_err_to_name(err));
     }
     else  // measure command successful, now send
     {
-        vTaskDelay(pdMS_TO_TICKS(20));
+        wake_phase_sensor_wait(20);
+        i2c_start_us = wake_phase_begin();
         err = i2c_master_receive(i2c_voc_device_handle, received_data, sizeof(received_data), pdMS_TO_TICKS(500));
+        wake_phase_end(WAKE_PHASE_I2C, i2c_start_us);
         if(err != ESP_OK)
         {
             ESP_LOGE(TAG, "Failed to read data: %s", esp_err_to_name(err));
@@ -71,14 +81,16 @@ void voc_task(void *parameter)
     while(1)
     {
         uint16_t readable_voc = 0;
+
+        // Only measure when the scheduler says a reading is due, with the wake lock given up while waiting
+        wake_scheduler_wait_until_due(WAKE_JOB_VOC, WAKE_LOCK_VOC);
+
         // Set data array to zero upon new read
         memset(received_data, 0, sizeof(received_data));
         if(xSemaphoreTake(voc_mutex, pdMS_TO_TICKS(1000)) == pdTRUE)
         {
-            // Allows all tasks to take their mutex upon startup
-            vTaskDelay(pdMS_TO_TICKS(200));
+            boot_timeline_mark(BOOT_EVENT_FIRST_I2C_COMMAND);
 
-            
             // On fresh power up, the sensor needs to initialize, then take 15 consecutive readings before it gets a valid value
             // Also check for recent button press because if button was pressed on startup, device will not enter sleep immediately
             // so we need to ensure there was no press as well
@@ -86,13 +98,13 @@ void voc_task(void *parameter)
             {
                 init_voc_sensor();
                 voc_sensor_initialized = true;
-                vTaskDelay(pdMS_TO_TICKS(50));
+                wake_phase_sensor_wait(50);
 
                 // take 20 readings on fresh startup to be safe and ensure readings area valid when we start storing data
                 for(uint8_t i = 0; i < 20; i++)
                 {
                     measure_voc_sensor();
-                    vTaskDelay(pdMS_TO_TICKS(1000));
+                    wake_phase_sensor_wait(1000);
                 }
             }
 
@@ -101,12 +113,8 @@ void voc_task(void *parameter)
             if(crc_check(&received_data[3], 2) == received_data[5])
             {
                 readable_voc = (received_data[3] << 8) | received_data[4];
-                // add the read voc value to the array, and increment to next index for next reading
-                if(sensor_data_buffer.co2_reading_index < MAX_SENSOR_READINGS)
-                {
-                    sensor_data_buffer.voc_measurement[sensor_data_buffer.voc_reading_index] = readable_voc;
-                    sensor_data_buffer.voc_reading_index++;
-                }
+                // filter the read voc value, and if accepted add it to the array for the next average
+                store_sensor_reading(SENSOR_METRIC_VOC, readable_voc);
 
                 ESP_LOGI(TAG, "%d ppb", readable_voc);
             }
@@ -116,7 +124,6 @@ void voc_task(void *parameter)
             }
         }
         xSemaphoreGive(voc_mutex);
-
-        vTaskDelay(pdMS_TO_TICKS(1000));
+        wake_scheduler_job_done(WAKE_JOB_VOC);
     }
 }
\ No newline at end of file
@@ -456,6 +456,8 @@ set(CONFIG_DAC_ENABLE_DEBUG_LOG "")
 set(CONFIG_LEDC_CTRL_FUNC_IN_IRAM "")
 set(CONFIG_I2C_ISR_IRAM_SAFE "")
 set(CONFIG_I2C_ENABLE_DEBUG_LOG "")
+set(CONFIG_DISPLAY_16X2 "y")
+set(CONFIG_DISPLAY_20X4 "")
 set(CONFIG_EFUSE_CUSTOM_TABLE "")
 set(CONFIG_EFUSE_VIRTUAL "")
 set(CONFIG_EFUSE_MAX_BLK_LEN "256")
@@ -521,6 +523,7 @@ set(CONFIG_ESP_SLEEP_WAIT_FLASH_READY_EXTRA_DELAY "0")
 set(CONFIG_ESP_SLEEP_CACHE_SAFE_ASSERTION "")
 set(CONFIG_ESP_SLEEP_DEBUG "")
 set(CONFIG_ESP_SLEEP_GPIO_ENABLE_INTERNAL_RESISTORS "y")
+set(CONFIG_ESP_SLEEP_EVENT_CALLBACKS "")
 set(CONFIG_RTC_CLK_SRC_INT_RC "y")
 set(CONFIG_RTC_CLK_SRC_EXT_CRYS "")
 set(CONFIG_RTC_CLK_SRC_EXT_OSC "")
@@ -549,7 +552,15 @@ set(CONFIG_ESP_PHY_RF_CAL_NONE "")
 set(CONFIG_ESP_PHY_RF_CAL_FULL "")
 set(CONFIG_ESP_PHY_CALIBRATION_MODE "0")
 set(CONFIG_ESP_PHY_PLL_TRACK_DEBUG "")
-set(CONFIG_PM_ENABLE "")
+set(CONFIG_PM_ENABLE "y")
+set(CONFIG_PM_DFS_INIT_AUTO "")
+set(CONFIG_PM_PROFILING "")
+set(CONFIG_PM_TRACE "")
+set(CONFIG_PM_SLP_IRAM_OPT "")
+set(CONFIG_PM_RTOS_IDLE_OPT "")
+set(CONFIG_PM_SLP_DISABLE_GPIO "")
+set(CONFIG_PM_LIGHTSLEEP_RTC_OSC_CAL_INTERVAL "1")
+set(CONFIG_PM_LIGHT_SLEEP_CALLBACKS "")
 set(CONFIG_SPIRAM "")
 set(CONFIG_RINGBUF_PLACE_FUNCTIONS_INTO_FLASH "")
 set(CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ_80 "")
@@ -741,6 +752,8 @@ set(CONFIG_FREERTOS_QUEUE_REGISTRY_SIZE "0")
 set(CONFIG_FREERTOS_TASK_NOTIFICATION_ARRAY_ENTRIES "1")
 set(CONFIG_FREERTOS_USE_TRACE_FACILITY "")
 set(CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS "")
+set(CONFIG_FREERTOS_USE_TICKLESS_IDLE "y")
+set(CONFIG_FREERTOS_IDLE_TIME_BEFORE_SLEEP "3")
 set(CONFIG_FREERTOS_USE_APPLICATION_TASK_TAG "")
 set(CONFIG_FREERTOS_TASK_FUNCTION_WRAPPER "y")
 set(CONFIG_FREERTOS_WATCHPOINT_END_OF_STACK "")
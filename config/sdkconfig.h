@@ -354,6 +354,7 @@
 #define CONFIG_SPI_MASTER_ISR_IN_IRAM 1
 #define CONFIG_SPI_SLAVE_ISR_IN_IRAM 1
 #define CONFIG_GPTIMER_ISR_HANDLER_IN_IRAM 1
+#define CONFIG_DISPLAY_16X2 1
 #define CONFIG_EFUSE_MAX_BLK_LEN 256
 #define CONFIG_ESP_TLS_USING_MBEDTLS 1
 #define CONFIG_ESP_TLS_USE_DS_PERIPHERAL 1
@@ -401,6 +402,8 @@
 #define CONFIG_ESP_PHY_MAX_TX_POWER 20
 #define CONFIG_ESP_PHY_RF_CAL_PARTIAL 1
 #define CONFIG_ESP_PHY_CALIBRATION_MODE 0
+#define CONFIG_PM_ENABLE 1
+#define CONFIG_PM_LIGHTSLEEP_RTC_OSC_CAL_INTERVAL 1
 #define CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ_160 1
 #define CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ 160
 #define CONFIG_ESP32S2_INSTRUCTION_CACHE_8KB 1
@@ -503,6 +506,8 @@
 #define CONFIG_FREERTOS_TIMER_QUEUE_LENGTH 10
 #define CONFIG_FREERTOS_QUEUE_REGISTRY_SIZE 0
 #define CONFIG_FREERTOS_TASK_NOTIFICATION_ARRAY_ENTRIES 1
+#define CONFIG_FREERTOS_USE_TICKLESS_IDLE 1
+#define CONFIG_FREERTOS_IDLE_TIME_BEFORE_SLEEP 3
 #define CONFIG_FREERTOS_TASK_FUNCTION_WRAPPER 1
 #define CONFIG_FREERTOS_TLSP_DELETION_CALLBACKS 1
 #define CONFIG_FREERTOS_CHECK_MUTEX_GIVEN_BY_OWNER 1
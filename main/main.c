@@ -12,66 +12,183 @@
 #include "esp_err.h"
 #include "esp_log.h"
 #include "iaq_ui.h"
+#include "display_render.h"
+#include "display_state.h"
 #include "user_control.h"
 #include "driver/i2c.h"
 #include "Userbuttons.h"
+#include "buzzer_patterns.h"
+#include "wake_lock.h"
+#include "wake_scheduler.h"
+#include "boot_timeline.h"
+#include "power_mode.h"
+#include "wake_phases.h"
+#include "esp_timer.h"
 #include "esp_sleep.h"
 
-#define WAKEUP_TIME 5000000  // five seconds
-
 // Needs to do something with this here, will not work because then on ever wake from deep sleep, current page is startup
 RTC_DATA_ATTR display_screen_pages_t current_page = STARTUP_SCREEN;
 
 /*********************************
- * @brief This task checks to see if all of the mutexes used by the sensors and display are free, as well as if any buzzers are on, and if there
- *        has been any recent user interaction. If so, then the device can sleep for 5 seconds
+ * @brief This task sleeps until no wake lock is held: every sensor has finished its measurement, no one-shot buzzer
+ *        pattern is playing, no frame is being sent, and there has been no user interaction in the last two minutes.
+ *        The device then goes straight into deep sleep until the next sensor reading is due. An alarm that keeps repeating does not keep the
+ *        device awake, the large buzzer is latched on through the sleep instead. With automatic light sleep on, a wait
+ *        short enough that a boot would cost more is spent in light sleep instead
  */
 void deep_sleep_monitor_task(void *parameter)
 {
-    // Allow all other tasks to begin
-    vTaskDelay(pdMS_TO_TICKS(1000));
-
-    // Check if any of the sensor mutexes are taken, if either buzzer is on, and if there has been recent user interaction,
-    // if none of these things are true, move on, otherwise delay and check again
-    ESP_LOGI("DEEP_SLEEP", "Checking if device is ready for deep sleep.....");
-    while((uxSemaphoreGetCount(temp_humid_mutex) == 0) || (uxSemaphoreGetCount(co2_mutex) == 0) || (uxSemaphoreGetCount(voc_mutex) == 0) || \
-           check_recent_user_interaction() || is_user_buzzer_on() || is_safety_buzzer_on())
-    {
-        vTaskDelay(pdMS_TO_TICKS(100));
-    }
+    uint64_t sleep_time_us = 0;
+    int64_t cycle_start_us = 0;  // Start of this wake cycle, moved on after each light sleep
+    int64_t sleep_entry_start_us = 0;
 
-    // Turn backlight off of the display
-    if(!is_display_off_in_consistent_sleep())
+    ESP_LOGI("DEEP_SLEEP", "Waiting for wake locks to be released.....");
+    while(1)
     {
+        wait_for_wake_locks_released(portMAX_DELAY);
+        sleep_entry_start_us = wake_phase_begin();
+
+        // Turn backlight off of the display, this does nothing if it is already off. A lock taken while this was
+        // sending (a button press) means the device is needed again, so go back to waiting
         power_down_display();
+        if(!are_wake_locks_released())
+        {
+            continue;
+        }
+
+        uint32_t awake_ms = (esp_timer_get_time() - cycle_start_us) / 1000;
+        sleep_time_us = wake_scheduler_get_sleep_time_us();
+        power_mode_log_report(awake_ms, sleep_time_us);
+        if(power_mode_choose(awake_ms, sleep_time_us) != ENERGY_MODE_LIGHT_SLEEP)
+        {
+            break;
+        }
+
+        wake_phase_end(WAKE_PHASE_SLEEP_ENTRY, sleep_entry_start_us);
+        wake_phase_end_cycle();
+
+        // Block until the next job is due. The idle task light sleeps meanwhile, and the sensor tasks wake up on
+        // their own and take their locks
+        vTaskDelay(pdMS_TO_TICKS(sleep_time_us / 1000));
+        cycle_start_us = esp_timer_get_time();
+        wake_phase_start_cycle();
     }
-    vTaskDelay(pdMS_TO_TICKS(700));
+
+    buzzer_prepare_for_sleep();
+    wake_lock_log_report();
+    boot_timeline_log_report();
     esp_sleep_enable_ext0_wakeup(PWR_BTN_PIN, 0);  // Wake-up from deep sleep when the power button is pressed
-    esp_sleep_enable_timer_wakeup(WAKEUP_TIME);    // Wake up after 5 seconds to take periodic measurements
+    esp_sleep_enable_timer_wakeup(sleep_time_us);  // Wake up when the next measurement is due
+    wake_phase_end(WAKE_PHASE_SLEEP_ENTRY, sleep_entry_start_us);
+    wake_phase_end_cycle();
+    // The reports and the display and buzzer shutdown above are the deepest this task goes, so check its headroom here
+    ESP_LOGI("DEEP_SLEEP", "Monitor stack headroom %u bytes", (unsigned)uxTaskGetStackHighWaterMark(NULL));
     ESP_LOGI("DEEP_SLEEP", "Entering Deep Sleep");
     esp_deep_sleep_start();
 }
 
 
-void app_main()
+/*********************************
+ * @brief The user only needs the display and buttons when they woke the device with the power button, or on power on.
+ *        A timer wake is for the sensors and the display stays off, only the power button is watched
+ */
+static bool is_interactive_wake()
+{
+    esp_sleep_wakeup_cause_t wakeup_cause = esp_sleep_get_wakeup_cause();
+    return wakeup_cause == ESP_SLEEP_WAKEUP_UNDEFINED || wakeup_cause == ESP_SLEEP_WAKEUP_EXT0;
+}
+
+/*********************************
+ * @brief Sets up what every wake needs: the I2C bus with the sensors, the buzzers and the display state the sleep
+ *        task and alarms use. The user buzzer PWM is left until an alarm first sounds
+ */
+static void init_core_subsystems()
 {
     // Initialize the SDA and SCL lines for I2C communication
-    // This function also currently initializes the PWM signal for the buzzer
     i2c_master_config();
+    buzzer_patterns_init();
+    display_render_init();
+    display_state_init();
+    boot_timeline_mark(BOOT_EVENT_CORE_READY);
+}
+
+/*********************************
+ * @brief Sets up the display on the bus and the buttons, and starts the tasks that draw and handle presses
+ */
+static void init_user_interface()
+{
+    i2c_display_device_init();
     button_init();
+    boot_timeline_mark(BOOT_EVENT_UI_READY);
 
-    // Initialize a Wi-Fi connection
-    // wifi_init_sta();  
-    // start_webserver(); 
+    xTaskCreate(display_render_task, "DISPLAY_RENDER_TASK", 1024 * 3, NULL, 4, NULL);
+    xTaskCreate(user_button_task, "BUTTON_TASK", 1024 * 4, NULL, 6, NULL);
+}
 
+/*********************************
+ * @brief Runs on a timer wake, waiting for the power button. A press brings up the display and buttons the same as a
+ *        power button wake would have. EXT0 only wakes the device while the button is held low, so without this a
+ *        press released before the device went back to sleep was lost. One released in the last moment before the
+ *        sleep monitor enters deep sleep still is
+ */
+static void power_button_watch_task(void *parameter)
+{
+    power_button_watch_init(xTaskGetCurrentTaskHandle());
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    ESP_LOGI("WAKE", "Power button pressed on a timer wake, bringing up the display");
+    init_user_interface();
+    show_display_for_user();
+    vTaskDelete(NULL);
+}
+
+/*********************************
+ * @brief Starts the sensor tasks. They each wait for their own job to be due, so a task whose job is not due on this
+ *        wake gives up its lock right away and does not keep the device awake
+ */
+static void start_sensor_tasks()
+{
+    // Each sensor task is held awake for its first measurement from before it starts, so the device cannot
+    // sleep in the gap before the task gets to run
+    wake_lock_acquire(WAKE_LOCK_TEMP_HUMIDITY);
+    wake_lock_acquire(WAKE_LOCK_CO2);
+    wake_lock_acquire(WAKE_LOCK_VOC);
 
-    //initialize tasks
     xTaskCreate(temp_humidity_task, "TEMP_HUMIDITY_TASk", 1024 * 3, NULL, 5, NULL);
     xTaskCreate(co2_task, "CO2_TASK", 1024 * 3, NULL, 5, NULL);
     xTaskCreate(voc_task, "VOC_TASK", 1024 * 3, NULL, 5, NULL);
+}
+
+
+void app_main()
+{
+    boot_timeline_mark(BOOT_EVENT_APP_MAIN);
+    wake_lock_init();
+    power_mode_init();
+    init_core_subsystems();
+
+    // Initialize a Wi-Fi connection, timed as the network phase
+    // int64_t network_start_us = wake_phase_begin();
+    // wifi_init_sta();  
+    // start_webserver(); 
+    // wake_phase_end(WAKE_PHASE_NETWORK, network_start_us);
+
+    // The buttons come up before the sensors on a power button wake, so the sensors start on the interactive cadence
+    if(is_interactive_wake())
+    {
+        init_user_interface();
+    }
+    else
+    {
+        xTaskCreate(power_button_watch_task, "PWR_BTN_WATCH", 1024 * 3, NULL, 6, NULL);
+    }
+    start_sensor_tasks();
+
+    // Averages the readings and evaluates the alarms, so it runs on every wake even with the display off
     xTaskCreate(display_task, "DISPLAY_TASK", 1024 * 4, NULL, 4, NULL);
-    xTaskCreate(user_button_task, "BUTTON_TASK", 1024 * 4, NULL, 6, NULL);
    
-    //Lowest priority task
-    xTaskCreate(deep_sleep_monitor_task, "DEEP_SLEEP_MONITOR", 1024 * 2, NULL, 1, NULL);
-}
\ No newline at end of file
+    //Lowest priority task. It formats the power, wake lock, boot and wake phase reports before every sleep
+    xTaskCreate(deep_sleep_monitor_task, "DEEP_SLEEP_MONITOR", 1024 * 4, NULL, 1, NULL);
+    boot_timeline_mark(BOOT_EVENT_TASKS_STARTED);
+    wake_phase_add(WAKE_PHASE_BOOT, boot_timeline_get_time_us(BOOT_EVENT_TASKS_STARTED));
+}